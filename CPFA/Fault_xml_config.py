@@ -43,7 +43,8 @@ class C_XML_CONFIG:
         self.VISUAL =            True                    # turn on/off visual simulator
 
         # General Config
-        self.THREAD_COUNT =      0
+        self.THREAD_COUNT =      0                       # ARGoS worker threads, controllers may step in parallel (0 = single thread)
+        self.PHYSICS_ENGINE =    "dyn2d"                 # id of the physics engine (the loop functions read the clock from it)
         self.SIM_LENGTH =        6000                    # length of experiment in seconds
         self.RANDOM_SEED =       0
         self.TPS =               16                      # ticks/steps per second
@@ -111,6 +112,8 @@ class C_XML_CONFIG:
         # Other Loop Function Settings
         self.DRAW_ID =           1                       # Draw bot IDs
         self.DRAW_TARGET_RAYS =  0                       # Draw directional rays to target (for each bot)
+        self.TARGET_RAY_LEN =    200                     # Number of target rays kept per bot (when drawing target rays)
+        self.HEADLESS =          0                       # 1 = skip drawing bookkeeping even with the visualizer (automatic without it)
         self.DRAW_TRAILS =       0                       # Draw pheromone trails
         self.DRAW_DENSITY_RATE = 4                       # Draw density rate of resources
         self.MAX_SIM_COUNT =     1                       # Max simulation counter
@@ -121,6 +124,7 @@ class C_XML_CONFIG:
         self.NEST_RAD =          0.25                    # Nest radius
         self.VFP =               0                       # Variable food placement
         self.FOOD_RAD =          0.05                    # Food radius
+        self.FOOD_LAYOUT_CACHE = ""                      # Directory of saved food layouts (empty = don't save them)
         self.DENSIFY =           "false"                 # Turn ON/OFF dense clusters
 
         self.fname_header = "\0"                         # Filename Header
@@ -284,7 +288,7 @@ class C_XML_CONFIG:
         self.BOT_COUNT = botCount
         self.BOTS_PER_GROUP = botCount/4
 
-    def createXML(self):
+    def createXML(self, xml_filename = "./experiments/CPFA_Fault_Simulation.xml"):
 
         self.setFname()
 
@@ -419,6 +423,8 @@ class C_XML_CONFIG:
         lf_settings = xml.createElement('settings')
         lf_settings.setAttribute('DrawIDs', str(self.DRAW_ID))
         lf_settings.setAttribute('DrawTargetRays', str(self.DRAW_TARGET_RAYS))
+        lf_settings.setAttribute('TargetRayTrailLength', str(self.TARGET_RAY_LEN))
+        lf_settings.setAttribute('Headless', str(self.HEADLESS))
         lf_settings.setAttribute('DrawTrails', str(self.DRAW_TRAILS))
         lf_settings.setAttribute('DrawDensityRate', str(self.DRAW_DENSITY_RATE))
         lf_settings.setAttribute('MaxSimCounter', str(self.MAX_SIM_COUNT))
@@ -429,6 +435,8 @@ class C_XML_CONFIG:
         lf_settings.setAttribute('NestRadius', str(self.NEST_RAD))
         lf_settings.setAttribute('VariableFoodPlacement', str(self.VFP))
         lf_settings.setAttribute('FoodRadius', str(self.FOOD_RAD))
+        lf_settings.setAttribute('FoodLayoutCache', str(self.FOOD_LAYOUT_CACHE))
+        lf_settings.setAttribute('PhysicsEngine', str(self.PHYSICS_ENGINE))
         lf_settings.setAttribute('UseFakeFoodOnly', str(self.USE_FF_ONLY))
         lf_settings.setAttribute('FoodDistribution', str(self.RFD))
         lf_settings.setAttribute('UseAltDistribution', str(self.USE_ALT_DIST))
@@ -697,7 +705,7 @@ class C_XML_CONFIG:
 
         #       <dynamics2d>
         dynamics = xml.createElement('dynamics2d')
-        dynamics.setAttribute('id','dyn2d')
+        dynamics.setAttribute('id', self.PHYSICS_ENGINE)
         physics_eng.appendChild(dynamics)
         #   </physics_engines>
 
@@ -755,7 +763,5 @@ class C_XML_CONFIG:
 
         xml_str = xml.toprettyxml(indent = "\t")
 
-        xml_filename = "./experiments/CPFA_Fault_Simulation.xml"
-
         with open(xml_filename, "w") as f:
             f.write(xml_str)
@@ -0,0 +1,71 @@
+import Fault_xml_config as config
+import os, re, shutil, subprocess, sys
+
+# Regression test for the pickup arbitration and the deferred controller writes:
+# the same seeded experiment must give the same results with a single thread and
+# with parallel controller steps. It must also give the same results when the food
+# layout is loaded from the layout cache instead of generated, since loading skips
+# the placement draws and must not shift any other random draw (e.g. fault injection).
+#
+# Usage: python3 ThreadDeterminism.py [threads]   (run from the CPFA directory after build.sh)
+
+THREADS = int(sys.argv[1]) if len(sys.argv) > 1 else 4
+SEED = 12345
+RESULTS_PATH = "results/thread_determinism/"
+LAYOUT_CACHE = RESULTS_PATH + "layouts"
+
+# PostExperiment prints "score, simulation time, seed"
+SCORE_LINE = re.compile(r'^-?\d+(\.\d+)?, \d+(\.\d+)?, \d+$')
+
+def Run(threads, layout_cache = ""):
+    XML = config.C_XML_CONFIG(1)
+    XML.VISUAL = False
+    XML.RANDOM_SEED = SEED
+    XML.THREAD_COUNT = threads
+    XML.SIM_LENGTH = 600
+    XML.MAX_SIM_TIME = 600
+    XML.RD_PATH = RESULTS_PATH
+    XML.UQZ = 'true'
+    XML.F_NUM = 1                   # inject faults so that the fault injection draws are covered too
+    XML.F_OFD = 0.5
+    XML.F_COUNT = 4
+    XML.F_TIME = 120
+    XML.FOOD_LAYOUT_CACHE = layout_cache
+
+    cached = '_cached' if layout_cache else ''
+    xml_filename = f'./experiments/CPFA_Threads{threads}{cached}.xml'
+    XML.createXML(xml_filename)
+
+    data_filename = XML.fname_header + 'DoSData.txt'
+    if os.path.exists(data_filename):
+        os.remove(data_filename)
+
+    print(f'Running {xml_filename}')
+    out = subprocess.run(["argos3", "-c", xml_filename], stdout = subprocess.PIPE, universal_newlines = True)
+    if out.returncode != 0:
+        sys.exit(f'ERROR: argos3 failed on {xml_filename} (exit code {out.returncode})')
+
+    scores = [line for line in out.stdout.splitlines() if SCORE_LINE.match(line.strip())]
+    with open(data_filename) as f:
+        data = f.readlines()[1:]
+
+    return scores, data
+
+def Compare(name, expected, actual):
+    if expected != actual:
+        print(f'FAILED: {name} differs from threads="0" without the layout cache')
+        print(f'  expected: {expected}')
+        print(f'  actual:   {actual}')
+        sys.exit(1)
+    print(f'OK: {name}')
+
+os.makedirs(RESULTS_PATH, exist_ok = True)
+if os.path.exists(LAYOUT_CACHE):
+    shutil.rmtree(LAYOUT_CACHE)
+
+reference = Run(0)
+Compare(f'threads="{THREADS}"', reference, Run(THREADS))
+Compare('cold layout cache', reference, Run(0, LAYOUT_CACHE))
+Compare('warm layout cache', reference, Run(0, LAYOUT_CACHE))
+
+print(f'OK: every run gives the same results {reference[0]}')
@@ -30,8 +30,13 @@ BaseController::BaseController() :
 	hasFault(0),
 	CurrentFaultType(NONE),
 	controllerID("none"),
-	cbiasSet(false)
+	cbiasSet(false),
+	ticksPerSecond(0),
+	secondsPerTick(0.0)
 {
+	Snapshot.Valid = false;
+	Snapshot.Tick = 0;
+
 	// calculate the forage range and compensate for the robot's radius of 0.085m
 	argos::CVector3 ArenaSize = LF.GetSpace().GetArenaSize();
 	argos::Real rangeX = (ArenaSize.GetX() / 2.0) - 0.085 - 0.1; //ryan luna 12/08/22 ** add -0.1 to avoid robots getting too close to wall
@@ -43,40 +48,60 @@ BaseController::BaseController() :
 	//GoStraightAngleRangeInDegrees.Set(-37.5, 37.5);	//does not work when collides with walls
 }
 
-argos::CRadians BaseController::GetHeading() {
-	/* in ARGoS, the robot's orientation is represented by a quaternion */
+/**
+ * Take the sensor snapshot for this tick. The readings only change in the sense phase,
+ * so everything computed from them here is valid until the next ControlStep.
+ */
+void BaseController::UpdateSensorSnapshot() {
+	/* the robot's compass sensor gives us a 3D position */
 	const argos::CCI_PositioningSensor::SReading& readings = compassSensor->GetReading();
-	argos::CQuaternion orientation = readings.Orientation;
+	float x = readings.Position.GetX();
+	float y = readings.Position.GetY();
+	Snapshot.RealPosition = argos::CVector2(x, y);
 
-	/* convert the quaternion to euler angles */
+	/* in ARGoS, the robot's orientation is represented by a quaternion */
 	argos::CRadians z_angle, y_angle, x_angle;
-	orientation.ToEulerAngles(z_angle, y_angle, x_angle);
-
+	readings.Orientation.ToEulerAngles(z_angle, y_angle, x_angle);
 	/* the angle to the z-axis represents the compass heading */
+	Snapshot.Heading = z_angle;
 
-	return z_angle;
-}
+	Snapshot.CollisionVector = GetCollisionVector();
 
-void BaseController::SetControllerID(string id) {
-	controllerID = id;
+	/* the believed position, offset by an injected localization fault */
+	CVector2 Offset = GenerateOffset();
+	x += Offset.GetX();
+	y += Offset.GetY();
+	Snapshot.Position = argos::CVector2(x, y);
+
+	Snapshot.Tick = SimulationTick();
+	Snapshot.Valid = true;
 }
 
-argos::CVector2 BaseController::GetPosition() {
-	/* the robot's compass sensor gives us a 3D position */
-	argos::CVector3 position3D = compassSensor->GetReading().Position;
-	/* return the 2D position components of the compass sensor reading */
+void BaseController::RefreshSensorSnapshot() {
+	if(!Snapshot.Valid || Snapshot.Tick != SimulationTick()) {
+		UpdateSensorSnapshot();
+	}
+}
 
-	float x = position3D.GetX();
-	float y = position3D.GetY();
+void BaseController::InvalidateSensorSnapshot() {
+	Snapshot.Valid = false;
+}
 
-	CVector2 Offset = GenerateOffset();
+argos::CRadians BaseController::GetHeading() {
+	RefreshSensorSnapshot();
+	return Snapshot.Heading;
+}
 
-	// if (hasFault){
-	// 	LOG << "Offset Generated: (" << Offset.GetX() << ", " << Offset.GetY() << ')' << endl;
-	// }
+void BaseController::SetControllerID(string id) {
+	controllerID = id;
+}
 
-	x += Offset.GetX();
-	y += Offset.GetY();
+/**
+ * The position the robot believes it is at: the compass reading plus the offset of an
+ * injected localization fault (see GenerateOffset()), taken from the sensor snapshot.
+ */
+argos::CVector2 BaseController::GetPosition() {
+	RefreshSensorSnapshot();
 
 	// Add noise to the current position unless travelling to the nest
 	// Make the noise proportional to the distance to the target
@@ -91,14 +116,12 @@ argos::CVector2 BaseController::GetPosition() {
 	}
 	*/
 
-	return argos::CVector2(x, y);
+	return Snapshot.Position;
 }
 
 argos::CVector2 BaseController::GetRealPosition() {
-	argos::CVector3 position3D = compassSensor->GetReading().Position;
-	float x = position3D.GetX();
-	float y = position3D.GetY();
-	return argos::CVector2(x, y);
+	RefreshSensorSnapshot();
+	return Snapshot.RealPosition;
 }
 
 argos::CVector2 BaseController::GetTarget() {
@@ -293,7 +316,8 @@ unsigned int BaseController::GetCollisionTime(){
  
 bool BaseController::CollisionDetection() {
 
-	argos::CVector2 collisionVector = GetCollisionVector();
+	RefreshSensorSnapshot();
+	argos::CVector2 collisionVector = Snapshot.CollisionVector;
 	argos::Real collisionAngle = ToDegrees(collisionVector.Angle()).GetValue();
 	bool isCollisionDetected = false;
         
@@ -441,14 +465,17 @@ size_t BaseController::SimulationTick() {
 	return LF.GetSpace().GetSimulationClock();
 }
 
+void BaseController::SetClockTick(size_t ticks_per_second) {
+	ticksPerSecond = ticks_per_second;
+	secondsPerTick = 1.0 / ticks_per_second;
+}
+
 size_t BaseController::SimulationTicksPerSecond() {
-	//return LF.GetSimulator().GetPhysicsEngine("default").GetInverseSimulationClockTick();
-    return LF.GetSimulator().GetPhysicsEngine("dyn2d").GetInverseSimulationClockTick();//qilu 02/06/2021 
+	return ticksPerSecond;
 }
 
 argos::Real BaseController::SimulationSecondsPerTick() {
-	//return LF.GetSimulator().GetPhysicsEngine("default").GetSimulationClockTick();
-    return LF.GetSimulator().GetPhysicsEngine("dyn2d").GetSimulationClockTick();//qilu 02/06/2021
+	return secondsPerTick;
 }
 
 argos::Real BaseController::SimulationTimeInSeconds() {
@@ -491,6 +518,8 @@ void BaseController::SetFault(	FaultType faultCode, argos::Real desiredOffsetDis
 		hasFault = false;
 	}
 	CurrentFaultType = faultCode;
+	// the snapshot's believed position depends on the fault
+	InvalidateSensorSnapshot();
 	offsetDistance = desiredOffsetDistance;
 	biasFrequency = desiredBiasFrequency;
 	frozenCoordinate = desiredFrozenCoordinate;
@@ -554,46 +583,31 @@ CVector2 BaseController::ConsistentBias(){
 }
 
 /**
- * Broadcast the input string to all controllers using the Range and Bearing Actuator
+ * Broadcast a packed message (see RABMessage) to all controllers using the Range and Bearing Actuator.
+ * The message is zero padded to the actuator's rab_data_size.
  * 
  * @param msg The message to be broadcast
 */
-void BaseController::Broadcast(string msg){
-	argos::CByteArray msgBuf;
-	msgBuf << msg << ',';
-	while (msgBuf.Size() < 192){
-		if (msgBuf.Size() < 192){
-			msgBuf << uint8_t(0);
-		} else {
-			break;
-		}
-	}
-	if (msgBuf.Size() > 192){
-		LOG << "msgBuf size: " << msgBuf.Size() << endl;
-		LOG << "msgBuf: " << msgBuf << endl;
-		LOG << "msg: " << msg << endl;
+void BaseController::Broadcast(const argos::CByteArray& msg){
+	size_t dataSize = RABActuator->GetSize();
+
+	if (msg.Size() > dataSize){
+		LOG << "Broadcast: message of " << msg.Size() << " bytes exceeds rab_data_size " << dataSize << ", dropped" << endl;
+		return;
 	}
-	// LOG << "send: " << msgBuf << endl;
-	RABActuator->SetData(msgBuf);
+
+	RABPacket = msg;
+	RABPacket.Resize(dataSize, 0);
+	RABActuator->SetData(RABPacket);
 }
 
 /**
  * Receive the broadcasted data from all controllers using the Range and Bearing Sensor
  * 
- * @return The received data as vector of tuples containing the message, range, and bearing.
+ * @return The sensor readings, each holding the raw message, range, and bearing.
 */
-vector<tuple<string, Real, CRadians>> BaseController::Receive(){
-	const CCI_RangeAndBearingSensor::TReadings& packetQ = RABSensor->GetReadings();
-	vector<tuple<string, Real, CRadians>> dataQ;
-
-	for (const CCI_RangeAndBearingSensor::SPacket& p : packetQ) {
-		string dataStr(reinterpret_cast<const char*>(p.Data.ToCArray()), p.Data.Size());
-		// LOG << "receive: " << p.Data << endl;
-
-		dataQ.push_back(make_tuple(dataStr, p.Range, p.HorizontalBearing));
-	}
-
-	return dataQ;
+const CCI_RangeAndBearingSensor::TReadings& BaseController::Receive(){
+	return RABSensor->GetReadings();
 }
 
 void BaseController::ClearRAB(){
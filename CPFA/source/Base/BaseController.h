@@ -41,6 +41,9 @@ class BaseController : public argos::CCI_Controller {
 		size_t SimulationTick();
 		size_t SimulationTicksPerSecond();
 		argos::Real SimulationSecondsPerTick();
+
+		/* the loop functions own the simulation clock rate and hand it to every controller */
+		void SetClockTick(size_t ticks_per_second);
 		argos::Real SimulationTimeInSeconds();
 
 		void SetIsHeadingToNest(bool n);
@@ -53,6 +56,14 @@ class BaseController : public argos::CCI_Controller {
 		*/
 		argos::CVector2 GetRealPosition();
 
+		/**
+		 * Read the pose and proximity sensors once for the current tick. Called at the top of
+		 * ControlStep; GetPosition(), GetRealPosition(), GetHeading() and the collision vector
+		 * are then served from this snapshot for the rest of the tick (including PostStep).
+		 * Accessors refresh a snapshot taken in an earlier tick on their own.
+		*/
+		void UpdateSensorSnapshot();
+
 
 		/******************************************************/
 
@@ -93,6 +104,7 @@ class BaseController : public argos::CCI_Controller {
 		argos::CCI_FootBotProximitySensor* proximitySensor;
 		argos::CCI_RangeAndBearingSensor* RABSensor;
 		argos::CCI_RangeAndBearingActuator* RABActuator;
+		argos::CByteArray RABPacket;		// send buffer reused by Broadcast()
 
 		// controller state variables
 		enum MovementState {
@@ -144,8 +156,11 @@ class BaseController : public argos::CCI_Controller {
 		void ClearFault();
 		void ClearRAB();
 
-		void Broadcast(std::string msg);
-		std::vector<std::tuple<std::string, argos::Real, argos::CRadians>> Receive();
+		/* force the next accessor to re-read the sensors, e.g. after the robot was moved on Reset */
+		void InvalidateSensorSnapshot();
+
+		void Broadcast(const argos::CByteArray& msg);
+		const argos::CCI_RangeAndBearingSensor::TReadings& Receive();
 		
 
 		/******************************************************/
@@ -210,6 +225,22 @@ class BaseController : public argos::CCI_Controller {
 
 		bool heading_to_nest;
 
+		/* simulation clock constants, set by SetClockTick() */
+		size_t ticksPerSecond;
+		argos::Real secondsPerTick;
+
+		/* sensor readings of the current tick, see UpdateSensorSnapshot() */
+		struct SensorSnapshot {
+			bool			Valid;
+			size_t			Tick;
+			argos::CVector2	RealPosition;
+			argos::CVector2	Position;			// RealPosition plus the localization fault offset
+			argos::CRadians	Heading;
+			argos::CVector2	CollisionVector;	// mean of the proximity readings
+		} Snapshot;
+
+		void RefreshSensorSnapshot();
+
 };
 
 #endif /* IANTBASECONTROLLER_H */
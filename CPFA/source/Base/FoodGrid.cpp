@@ -0,0 +1,146 @@
+#include "FoodGrid.h"
+
+FoodGrid::FoodGrid():
+    MinX(0.0),
+    MinY(0.0),
+    CellSize(1.0),
+    NumCellsX(1),
+    NumCellsY(1),
+    NumEntries(0)
+{
+    Cells.resize(1);
+}
+
+void FoodGrid::Init(CRange<Real> rangeX, CRange<Real> rangeY, Real cellSize){
+    MinX = rangeX.GetMin();
+    MinY = rangeY.GetMin();
+    CellSize = (cellSize > 0.0) ? cellSize : 1.0;
+    NumCellsX = (size_t)ceil((rangeX.GetMax() - rangeX.GetMin()) / CellSize) + 1;
+    NumCellsY = (size_t)ceil((rangeY.GetMax() - rangeY.GetMin()) / CellSize) + 1;
+
+    Cells.clear();
+    Cells.resize(NumCellsX * NumCellsY);
+    FoodCell.clear();
+    FoodSlot.clear();
+    NumEntries = 0;
+}
+
+void FoodGrid::Clear(){
+    for(size_t i = 0; i < Cells.size(); i++){
+        Cells[i].clear();
+    }
+    FoodCell.clear();
+    FoodSlot.clear();
+    NumEntries = 0;
+}
+
+void FoodGrid::Build(vector<Food>& FoodList){
+    Clear();
+    FoodCell.reserve(FoodList.size());
+    FoodSlot.reserve(FoodList.size());
+    for(size_t i = 0; i < FoodList.size(); i++){
+        Insert(i, FoodList[i].GetLocation());
+    }
+}
+
+void FoodGrid::Insert(size_t foodIdx, const CVector2& location){
+    if(foodIdx >= FoodCell.size()){
+        FoodCell.resize(foodIdx + 1);
+        FoodSlot.resize(foodIdx + 1);
+    }
+    size_t c = CellOf(location);
+    FoodCell[foodIdx] = c;
+    FoodSlot[foodIdx] = Cells[c].size();
+    Cells[c].push_back(foodIdx);
+    NumEntries++;
+}
+
+void FoodGrid::Remove(size_t foodIdx){
+    size_t c = FoodCell[foodIdx];
+    size_t s = FoodSlot[foodIdx];
+    size_t moved = Cells[c].back();
+
+    Cells[c][s] = moved;
+    FoodSlot[moved] = s;
+    Cells[c].pop_back();
+    NumEntries--;
+
+    if(foodIdx + 1 == FoodCell.size()){
+        FoodCell.pop_back();
+        FoodSlot.pop_back();
+    }
+}
+
+/**
+ * FoodList[oldIdx] has been moved to FoodList[newIdx]; point the grid entry at its new index.
+ * 'newIdx' must not be an active entry (i.e. it has already been removed).
+ */
+void FoodGrid::Relabel(size_t oldIdx, size_t newIdx){
+    size_t c = FoodCell[oldIdx];
+    size_t s = FoodSlot[oldIdx];
+
+    Cells[c][s] = newIdx;
+    FoodCell[newIdx] = c;
+    FoodSlot[newIdx] = s;
+
+    if(oldIdx + 1 == FoodCell.size()){
+        FoodCell.pop_back();
+        FoodSlot.pop_back();
+    }
+}
+
+void FoodGrid::Query(const CVector2& center, Real radius, vector<Food>& FoodList, vector<size_t>& result, bool inclusive) const {
+    Visit(center, radius, FoodList, inclusive, &result);
+}
+
+bool FoodGrid::Any(const CVector2& center, Real radius, vector<Food>& FoodList) const {
+    return Visit(center, radius, FoodList, false, NULL);
+}
+
+bool FoodGrid::Visit(const CVector2& center, Real radius, vector<Food>& FoodList, bool inclusive, vector<size_t>* result) const {
+    Real radiusSquared = radius * radius;
+    bool hit = false;
+
+    size_t x_min = CellX(center.GetX() - radius);
+    size_t x_max = CellX(center.GetX() + radius);
+    size_t y_min = CellY(center.GetY() - radius);
+    size_t y_max = CellY(center.GetY() + radius);
+
+    for(size_t y = y_min; y <= y_max; y++){
+        for(size_t x = x_min; x <= x_max; x++){
+            const vector<size_t>& cell = Cells[y * NumCellsX + x];
+            for(size_t k = 0; k < cell.size(); k++){
+                Real d = (center - FoodList[cell[k]].GetLocation()).SquareLength();
+                if(d < radiusSquared || (inclusive && d == radiusSquared)){
+                    if(result == NULL) return true;
+                    result->push_back(cell[k]);
+                    hit = true;
+                }
+            }
+        }
+    }
+
+    return hit;
+}
+
+size_t FoodGrid::Size(){
+    return NumEntries;
+}
+
+size_t FoodGrid::CellX(Real x) const {
+    Real c = floor((x - MinX) / CellSize);
+    if(c < 0.0) return 0;
+    if(c >= (Real)NumCellsX) return NumCellsX - 1;
+    return (size_t)c;
+}
+
+size_t FoodGrid::CellY(Real y) const {
+    Real c = floor((y - MinY) / CellSize);
+    if(c < 0.0) return 0;
+    if(c >= (Real)NumCellsY) return NumCellsY - 1;
+    return (size_t)c;
+}
+
+size_t FoodGrid::CellOf(const CVector2& location) const {
+    return CellY(location.GetY()) * NumCellsX + CellX(location.GetX());
+}
@@ -0,0 +1,79 @@
+#ifndef FOODGRID_H_
+#define FOODGRID_H_
+
+#include <argos3/core/utility/math/vector2.h>
+#include <argos3/core/utility/math/range.h>
+#include <vector>
+#include <algorithm>
+
+#include <source/Base/Food.h>
+
+using namespace argos;
+using namespace std;
+
+/**
+ * Uniform grid spatial index over the loop functions' FoodList.
+ *
+ * The grid stores FoodList indices bucketed by cell so that radius queries only
+ * visit the cells overlapping the query circle. Each food remembers its cell and
+ * its slot inside that cell, which makes removal O(1) (swap-and-pop inside the cell).
+ *
+ * The owner is responsible for keeping the indices in sync with FoodList: when an
+ * entry of FoodList is moved (e.g. swap-and-pop removal), call Relabel().
+ **/
+class FoodGrid {
+
+    public:
+
+        FoodGrid();
+
+        /* set the covered area and the cell size, removes all entries */
+        void Init(CRange<Real> rangeX, CRange<Real> rangeY, Real cellSize);
+
+        /* remove all entries but keep the grid layout */
+        void Clear();
+
+        /* rebuild the index from scratch so that entry i refers to FoodList[i] */
+        void Build(vector<Food>& FoodList);
+
+        void Insert(size_t foodIdx, const CVector2& location);
+        void Remove(size_t foodIdx);
+        void Relabel(size_t oldIdx, size_t newIdx);
+
+        /**
+         * Append the index of every food within 'radius' of 'center' to 'result'.
+         * 'result' is not cleared so callers can reuse the same buffer.
+         * Food exactly at 'radius' is only reported when 'inclusive' is set.
+         */
+        void Query(const CVector2& center, Real radius, vector<Food>& FoodList, vector<size_t>& result, bool inclusive = false) const;
+
+        /* true if any food lies within 'radius' of 'center', stops at the first hit */
+        bool Any(const CVector2& center, Real radius, vector<Food>& FoodList) const;
+
+        size_t Size();
+
+    private:
+
+        size_t CellX(Real x) const;
+        size_t CellY(Real y) const;
+        size_t CellOf(const CVector2& location) const;
+
+        /**
+         * Visit the food within 'radius' of 'center' cell by cell. Every hit is appended to
+         * 'result'; without a 'result' the visit stops at the first hit. Returns true on a hit.
+         */
+        bool Visit(const CVector2& center, Real radius, vector<Food>& FoodList, bool inclusive, vector<size_t>* result) const;
+
+        Real            MinX;
+        Real            MinY;
+        Real            CellSize;
+        size_t          NumCellsX;
+        size_t          NumCellsY;
+        size_t          NumEntries;
+
+        vector< vector<size_t> >    Cells;      // food indices per cell
+        vector<size_t>              FoodCell;   // cell of each food index
+        vector<size_t>              FoodSlot;   // position of each food index inside its cell
+};
+
+#endif
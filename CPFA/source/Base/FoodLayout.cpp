@@ -0,0 +1,99 @@
+#include "FoodLayout.h"
+
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
+#include <unistd.h>
+
+static const char LAYOUT_MAGIC[8] = {'C', 'P', 'F', 'A', 'F', 'L', 'Y', '1'};
+
+FoodLayout::FoodLayout():
+    NumRealFood(0),
+    NumFakeFood(0)
+{}
+
+bool FoodLayout::Load(const string& path, const string& key){
+    ifstream in(path.c_str(), ios::binary);
+    if(!in) return false;
+
+    char magic[sizeof(LAYOUT_MAGIC)];
+    uint32_t keyLength = 0;
+    in.read(magic, sizeof(magic));
+    in.read((char*)&keyLength, sizeof(keyLength));
+    if(!in || memcmp(magic, LAYOUT_MAGIC, sizeof(magic)) != 0 || keyLength != key.size()){
+        return false;
+    }
+
+    string storedKey(keyLength, '\0');
+    in.read(&storedKey[0], keyLength);
+    if(!in || storedKey != key) return false;
+
+    uint64_t numReal = 0, numFake = 0, count = 0;
+    in.read((char*)&numReal, sizeof(numReal));
+    in.read((char*)&numFake, sizeof(numFake));
+    in.read((char*)&count, sizeof(count));
+    if(!in) return false;
+
+    // a corrupt count must not size the allocation, every food takes 17 bytes of the rest of the file
+    static const uint64_t FOOD_RECORD_SIZE = 2 * sizeof(double) + sizeof(uint8_t);
+    streampos dataStart = in.tellg();
+    in.seekg(0, ios::end);
+    streampos dataEnd = in.tellg();
+    in.seekg(dataStart);
+    if(!in || dataEnd < dataStart || count > (uint64_t)(dataEnd - dataStart) / FOOD_RECORD_SIZE) return false;
+
+    vector<Food> foods;
+    foods.reserve(count);
+    for(uint64_t i = 0; i < count; i++){
+        double x, y;
+        uint8_t type;
+        in.read((char*)&x, sizeof(x));
+        in.read((char*)&y, sizeof(y));
+        in.read((char*)&type, sizeof(type));
+        if(!in) return false;
+        foods.push_back(Food(CVector2(x, y), (type == Food::REAL) ? Food::REAL : Food::FAKE));
+    }
+
+    Key = key;
+    FoodList.swap(foods);
+    NumRealFood = numReal;
+    NumFakeFood = numFake;
+    return true;
+}
+
+bool FoodLayout::Save(const string& path) const {
+    // per process, so concurrent trials writing the same layout do not share a temporary file
+    string tempPath = path + "." + to_string(getpid()) + ".tmp";
+    {
+        ofstream out(tempPath.c_str(), ios::binary | ios::trunc);
+        if(!out) return false;
+
+        uint32_t keyLength = Key.size();
+        uint64_t numReal = NumRealFood, numFake = NumFakeFood, count = FoodList.size();
+        out.write(LAYOUT_MAGIC, sizeof(LAYOUT_MAGIC));
+        out.write((const char*)&keyLength, sizeof(keyLength));
+        out.write(Key.data(), keyLength);
+        out.write((const char*)&numReal, sizeof(numReal));
+        out.write((const char*)&numFake, sizeof(numFake));
+        out.write((const char*)&count, sizeof(count));
+
+        for(size_t i = 0; i < FoodList.size(); i++){
+            /* Food's getters are not const */
+            Food food = FoodList[i];
+            double x = food.GetLocation().GetX();
+            double y = food.GetLocation().GetY();
+            uint8_t type = food.GetType();
+            out.write((const char*)&x, sizeof(x));
+            out.write((const char*)&y, sizeof(y));
+            out.write((const char*)&type, sizeof(type));
+        }
+
+        out.flush();
+        if(!out){
+            remove(tempPath.c_str());
+            return false;
+        }
+    }
+    return rename(tempPath.c_str(), path.c_str()) == 0;
+}
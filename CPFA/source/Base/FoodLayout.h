@@ -0,0 +1,36 @@
+#ifndef FOODLAYOUT_H_
+#define FOODLAYOUT_H_
+
+#include <source/Base/Food.h>
+#include <vector>
+#include <string>
+
+using namespace argos;
+using namespace std;
+
+/**
+ * A generated food layout, i.e. the FoodList left by the placement generators plus the
+ * food counts they adjusted, tagged with a key describing everything the generation
+ * depended on (distribution settings, arena and RNG seed).
+ *
+ * Layouts are stored in a compact binary file: a magic string, the key, the two counts
+ * and then x, y (doubles) and the FoodType (one byte) of each food. Save() writes to a
+ * temporary file and renames it, so concurrent trials never read a partial layout.
+ **/
+class FoodLayout {
+
+    public:
+
+        FoodLayout();
+
+        /* load 'path', false if it is missing, malformed or was generated for another key */
+        bool Load(const string& path, const string& key);
+        bool Save(const string& path) const;
+
+        string          Key;
+        vector<Food>    FoodList;
+        size_t          NumRealFood;
+        size_t          NumFakeFood;
+};
+
+#endif
@@ -49,7 +49,7 @@ size_t Nest:: GetNestIdx(){
      return nest_idx;
  } 
 
-void Nest::CreateZone(size_t merge_mode, vector<Food>AllFood, vector<Food> LocalList, Food CentralResource, Real ScanDistance){
+void Nest::CreateZone(size_t merge_mode, vector<Food>& AllFood, FoodGrid& FoodIndex, vector<Food> LocalList, Food CentralResource, Real ScanDistance){
 
     Real radius = ScanDistance;
 
@@ -75,7 +75,7 @@ void Nest::CreateZone(size_t merge_mode, vector<Food>AllFood, vector<Food> Local
             // No merging
             break;
         case 1:
-            DistanceBasedMerging(AllFood, newZone);
+            DistanceBasedMerging(AllFood, FoodIndex, newZone);
             break;
         default:
             argos::LOGERR << "ERROR: Invalid Merge Mode in XML file.\n";
@@ -86,7 +86,7 @@ vector<QZone> Nest::GetZoneList(){
     return ZoneList;
 }
 
-void Nest::DistanceBasedMerging(vector<Food> AllFood, QZone Catalyst){
+void Nest::DistanceBasedMerging(vector<Food>& AllFood, FoodGrid& FoodIndex, QZone Catalyst){
 
     bool CanMerge = false;
     QZone* qz_i;
@@ -188,12 +188,13 @@ void Nest::DistanceBasedMerging(vector<Food> AllFood, QZone Catalyst){
         QZone MergedZone(newCenter,newRadius);
         MergedZone.SetColor(CColor::RED);
 
-        // go through food list and add food within new zone
+        // ask the food index for the food within the new zone, boundary included
 
-        for (Food fp: AllFood){
-            if ((MergedZone.GetLocation() - fp.GetLocation()).Length() <= MergedZone.GetRadius()){
-                MergedZone.AddFood(fp);
-            }
+        vector<size_t> ZoneFood;
+        FoodIndex.Query(MergedZone.GetLocation(), MergedZone.GetRadius(), AllFood, ZoneFood, true);
+        sort(ZoneFood.begin(), ZoneFood.end());
+        for (size_t k = 0; k < ZoneFood.size(); k++){
+            MergedZone.AddFood(AllFood[ZoneFood[k]]);
         }
 
         if(ConfirmMerge){
@@ -225,6 +226,6 @@ void Nest::DistanceBasedMerging(vector<Food> AllFood, QZone Catalyst){
                 }
             }
         }
-        DistanceBasedMerging(AllFood, Catalyst);
+        DistanceBasedMerging(AllFood, FoodIndex, Catalyst);
     }
 }
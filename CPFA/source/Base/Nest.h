@@ -8,6 +8,7 @@
 #include "Pheromone.h"
 #include "Food.h"       // Ryan Luna 11/10/22
 #include "QuarantineZone.h" // Ryan Luna 1/24/23
+#include "FoodGrid.h"
 using namespace argos;
 using namespace std;
 
@@ -34,13 +35,13 @@ class Nest {
                 void SetNestIdx(size_t idx);
                 size_t GetNestIdx();
 
-                void CreateZone(size_t merge_mode, vector<Food>AllFood, vector<Food> LocalList, Food CentralResource, Real ScanDistance);
+                void CreateZone(size_t merge_mode, vector<Food>& AllFood, FoodGrid& FoodIndex, vector<Food> LocalList, Food CentralResource, Real ScanDistance);
 
                 vector<QZone> GetZoneList();
         
 	private:
 
-                void DistanceBasedMerging(vector<Food>AllFood, QZone Catalyst); 
+                void DistanceBasedMerging(vector<Food>& AllFood, FoodGrid& FoodIndex, QZone Catalyst); 
                 CVector2 nestLocation;
                 size_t nest_idx;
 
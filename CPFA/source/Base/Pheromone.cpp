@@ -1,4 +1,5 @@
 #include "Pheromone.h"
+#include <limits>
 
 /*****
  * The  pheromone needs to keep track of four things:
@@ -73,7 +74,7 @@ argos::CVector2 Pheromone::GetLocation() {
 /*****
  * Return the trail between the pheromone and the nest.
  *****/
-std::vector<argos::CVector2> Pheromone::GetTrail() {
+const std::vector<argos::CVector2>& Pheromone::GetTrail() const {
     return trail;
 }
 
@@ -83,6 +84,33 @@ std::vector<argos::CVector2> Pheromone::GetTrail() {
 argos::Real Pheromone::GetWeight() {
 	return weight;
 }
+
+/*****
+ * Return the weight at 'time' without modifying the pheromone; the decay since
+ * the last Update() is evaluated analytically.
+ *****/
+argos::Real Pheromone::GetWeight(argos::Real time) const {
+    return weight * exp(-decayRate * (time - lastUpdated));
+}
+
+/*****
+ * Return the time at which the weight decays to the threshold, i.e. the pheromone
+ * stops being active. Pheromones that do not decay never expire (returns infinity).
+ *****/
+argos::Real Pheromone::GetExpiryTime() const {
+    if(weight <= threshold) return lastUpdated;
+    if(decayRate <= 0.0) return std::numeric_limits<argos::Real>::infinity();
+    return lastUpdated + log(weight / threshold) / decayRate;
+}
+
+argos::Real Pheromone::GetDecayRate() const {
+    return decayRate;
+}
+
+argos::Real Pheromone::GetLastUpdated() const {
+    return lastUpdated;
+}
+
 size_t  Pheromone::GetResourceDensity(){
     return ResourceDensity;
 }
@@ -95,3 +123,7 @@ size_t  Pheromone::GetResourceDensity(){
 bool Pheromone::IsActive() {
 	return (weight > threshold);
 }
+
+bool Pheromone::IsActive(argos::Real time) const {
+	return (GetWeight(time) > threshold);
+}
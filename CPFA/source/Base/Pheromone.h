@@ -21,10 +21,15 @@ class Pheromone {
         void                         UpdateLocation(argos::CVector2  location); //qilu 09/12/2016
         void                         Deactivate();
         argos::CVector2              GetLocation();
-        std::vector<argos::CVector2> GetTrail();
+        const std::vector<argos::CVector2>& GetTrail() const;
         argos::Real                  GetWeight();
+        argos::Real                  GetWeight(argos::Real time) const;
+        argos::Real                  GetExpiryTime() const;
+        argos::Real                  GetDecayRate() const;
+        argos::Real                  GetLastUpdated() const;
         size_t                       GetResourceDensity();
         bool                          IsActive();
+        bool                         IsActive(argos::Real time) const;
         argos::CVector2              location;
         size_t ResourceDensity;
 
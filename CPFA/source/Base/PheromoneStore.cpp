@@ -0,0 +1,212 @@
+#include "PheromoneStore.h"
+#include <limits>
+#include <cmath>
+
+/* when a new pheromone's weight at the group's reference time exceeds this, move the reference time forward */
+static const Real REBASE_WEIGHT = 1e12;
+
+PheromoneStore::PheromoneStore():
+    NextId(0),
+    TreeUpdates(0)
+{}
+
+void PheromoneStore::Add(const Pheromone& p){
+    size_t id = NextId++;
+    size_t slot = Pheromones.size();
+
+    Slots[id] = slot;
+    Pheromones.push_back(p);
+    Ids.push_back(id);
+
+    const Pheromone& added = Pheromones.back();
+    size_t g = GroupOf(added.GetDecayRate(), added.GetLastUpdated());
+    Groups.push_back(g);
+    Bases.push_back(added.GetWeight(DecayGroups[g].RefTime));
+
+    if(Bases.back() > REBASE_WEIGHT){
+        /* the exponent grew too large: restate the whole group relative to the new pheromone */
+        DecayGroups[g].RefTime = added.GetLastUpdated();
+        for(size_t i = 0; i < Pheromones.size(); i++){
+            if(Groups[i] == g) Bases[i] = Pheromones[i].GetWeight(DecayGroups[g].RefTime);
+        }
+        for(size_t k = 0; k < DecayGroups.size(); k++) Rebuild(k);
+    } else {
+        /* append one Fenwick node to every tree; node n covers slots (n - lowbit(n), n] */
+        size_t n = slot + 1;
+        size_t low = n - (n & (~n + 1));
+        for(size_t k = 0; k < DecayGroups.size(); k++){
+            Real node = TreePrefix(k, n - 1) - TreePrefix(k, low);
+            if(k == g) node += Bases[slot];
+            DecayGroups[k].Tree.push_back(node);
+        }
+    }
+
+    /* pheromones that never decay are never expired */
+    Real expiry = added.GetExpiryTime();
+    if(expiry < numeric_limits<Real>::infinity()){
+        Expiry e;
+        e.Time = expiry;
+        e.Id = id;
+        ExpiryHeap.push(e);
+    }
+}
+
+void PheromoneStore::Clear(){
+    Pheromones.clear();
+    Ids.clear();
+    Groups.clear();
+    Bases.clear();
+    Slots.clear();
+    DecayGroups.clear();
+    TreeUpdates = 0;
+    ExpiryHeap = priority_queue<Expiry, vector<Expiry>, greater<Expiry> >();
+}
+
+void PheromoneStore::Expire(Real time){
+    while(!ExpiryHeap.empty() && ExpiryHeap.top().Time <= time){
+        size_t id = ExpiryHeap.top().Id;
+        ExpiryHeap.pop();
+
+        unordered_map<size_t, size_t>::iterator it = Slots.find(id);
+        if(it == Slots.end()) continue;
+
+        RemoveSlot(it->second);
+    }
+}
+
+bool PheromoneStore::Sample(Real time, Real u, size_t& index){
+    size_t n = Pheromones.size();
+    if(n == 0) return false;
+
+    /* total weight of each group at 'time' */
+    Real total = 0.0;
+    vector<Real> scale(DecayGroups.size());
+    vector<Real> groupTotal(DecayGroups.size());
+    for(size_t k = 0; k < DecayGroups.size(); k++){
+        scale[k] = exp(-DecayGroups[k].Rate * (time - DecayGroups[k].RefTime));
+        groupTotal[k] = max(TreePrefix(k, n), 0.0) * scale[k];
+        total += groupTotal[k];
+    }
+    if(total <= 0.0) return false;
+
+    Real target = u * total;
+    size_t g = 0;
+    for(size_t k = 0; k < DecayGroups.size(); k++){
+        if(groupTotal[k] <= 0.0) continue;
+        g = k;
+        if(target < groupTotal[k]) break;
+        target -= groupTotal[k];
+    }
+
+    index = TreeFind(g, min(target / scale[g], TreePrefix(g, n)));
+
+    /* rounding in the tree can land past the last positive entry of the group */
+    if(index >= n || Groups[index] != g || Bases[index] <= 0.0){
+        for(index = n; index > 0 && (Groups[index - 1] != g || Bases[index - 1] <= 0.0); index--);
+        if(index == 0) return false;
+        index--;
+    }
+    return true;
+}
+
+size_t PheromoneStore::Size(){
+    return Pheromones.size();
+}
+
+Pheromone& PheromoneStore::operator[](size_t i){
+    return Pheromones[i];
+}
+
+/*****
+ * Swap-and-pop removal of slot i, keeping the trees and the id -> slot map in sync.
+ *****/
+void PheromoneStore::RemoveSlot(size_t i){
+    size_t last = Pheromones.size() - 1;
+
+    TreeAdd(Groups[i], i, -Bases[i]);
+    Slots.erase(Ids[i]);
+
+    if(i != last){
+        TreeAdd(Groups[last], last, -Bases[last]);
+        TreeAdd(Groups[last], i, Bases[last]);
+
+        Pheromones[i] = Pheromones[last];
+        Ids[i] = Ids[last];
+        Groups[i] = Groups[last];
+        Bases[i] = Bases[last];
+        Slots[Ids[i]] = i;
+    }
+
+    Pheromones.pop_back();
+    Ids.pop_back();
+    Groups.pop_back();
+    Bases.pop_back();
+    for(size_t k = 0; k < DecayGroups.size(); k++){
+        DecayGroups[k].Tree.pop_back();
+    }
+
+    /* repeated +/- updates accumulate rounding error, rebuild every so often */
+    if(++TreeUpdates > Pheromones.size() + 64){
+        for(size_t k = 0; k < DecayGroups.size(); k++) Rebuild(k);
+    }
+}
+
+size_t PheromoneStore::GroupOf(Real rate, Real time){
+    for(size_t k = 0; k < DecayGroups.size(); k++){
+        if(DecayGroups[k].Rate == rate) return k;
+    }
+
+    DecayGroup group;
+    group.Rate = rate;
+    group.RefTime = time;
+    group.Tree.assign(Pheromones.size(), 0.0);    // slot 0 is unused, the new pheromone's node is appended by Add()
+    DecayGroups.push_back(group);
+    return DecayGroups.size() - 1;
+}
+
+void PheromoneStore::Rebuild(size_t g){
+    size_t n = Pheromones.size();
+    vector<Real>& tree = DecayGroups[g].Tree;
+
+    tree.assign(n + 1, 0.0);
+    for(size_t i = 1; i <= n; i++){
+        if(Groups[i - 1] == g) tree[i] += Bases[i - 1];
+        size_t parent = i + (i & (~i + 1));
+        if(parent <= n) tree[parent] += tree[i];
+    }
+    TreeUpdates = 0;
+}
+
+void PheromoneStore::TreeAdd(size_t g, size_t slot, Real delta){
+    vector<Real>& tree = DecayGroups[g].Tree;
+    for(size_t i = slot + 1; i < tree.size(); i += i & (~i + 1)){
+        tree[i] += delta;
+    }
+}
+
+/* sum of the first 'count' slots */
+Real PheromoneStore::TreePrefix(size_t g, size_t count){
+    const vector<Real>& tree = DecayGroups[g].Tree;
+    Real sum = 0.0;
+    for(size_t i = count; i > 0; i -= i & (~i + 1)){
+        sum += tree[i];
+    }
+    return sum;
+}
+
+/* first slot whose prefix sum (inclusive) exceeds 'target' */
+size_t PheromoneStore::TreeFind(size_t g, Real target){
+    const vector<Real>& tree = DecayGroups[g].Tree;
+    size_t n = tree.size() - 1;
+    size_t pos = 0;
+    size_t step = 1;
+    while(step * 2 <= n) step *= 2;
+
+    for(; step > 0; step /= 2){
+        if(pos + step <= n && tree[pos + step] <= target){
+            pos += step;
+            target -= tree[pos];
+        }
+    }
+    return pos;
+}
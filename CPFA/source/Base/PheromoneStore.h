@@ -0,0 +1,81 @@
+#ifndef PHEROMONESTORE_H_
+#define PHEROMONESTORE_H_
+
+#include <source/Base/Pheromone.h>
+#include <vector>
+#include <queue>
+#include <unordered_map>
+
+using namespace argos;
+using namespace std;
+
+/*****
+ * Container for the loop functions' active pheromones.
+ *
+ * Pheromone weights are never stored decayed, they are evaluated on demand with
+ * Pheromone::GetWeight(time). Each pheromone's expiry time is known when it is added,
+ * so expiry is driven by a min-heap on that time: Expire() only touches the pheromones
+ * that actually died and removes them in place (swap-and-pop, so order is not preserved).
+ *
+ * Weighted selection (Sample) uses one Fenwick tree per decay rate. Pheromones sharing a
+ * rate decay by the same factor, so the tree stores their weights at a fixed reference
+ * time and the relative weights never need updating as time passes.
+ *****/
+class PheromoneStore {
+
+    public:
+
+        PheromoneStore();
+
+        void        Add(const Pheromone& p);
+        void        Clear();
+
+        /* remove every pheromone whose weight has dropped to its threshold by 'time' */
+        void        Expire(Real time);
+
+        /**
+         * Pick a pheromone with probability proportional to its weight at 'time'.
+         * @param u uniform random number in [0,1)
+         * @return false if there is no pheromone with positive weight
+         */
+        bool        Sample(Real time, Real u, size_t& index);
+
+        size_t      Size();
+        Pheromone&  operator[](size_t i);
+
+    private:
+
+        struct Expiry {
+            Real    Time;
+            size_t  Id;
+            bool operator>(const Expiry& other) const { return Time > other.Time; }
+        };
+
+        /* pheromones with the same decay rate, weights stored at RefTime */
+        struct DecayGroup {
+            Real            Rate;
+            Real            RefTime;
+            vector<Real>    Tree;       // Fenwick tree over store slots, 1-based
+        };
+
+        void        RemoveSlot(size_t i);
+        size_t      GroupOf(Real rate, Real time);
+        void        Rebuild(size_t g);
+        void        TreeAdd(size_t g, size_t slot, Real delta);
+        Real        TreePrefix(size_t g, size_t count);
+        size_t      TreeFind(size_t g, Real target);
+
+        vector<Pheromone>               Pheromones;
+        vector<size_t>                  Ids;        // Ids[i] is the id of Pheromones[i]
+        vector<size_t>                  Groups;     // Groups[i] is the decay group of Pheromones[i]
+        vector<Real>                    Bases;      // Bases[i] is the weight of Pheromones[i] at its group's RefTime
+        unordered_map<size_t, size_t>   Slots;      // id -> index in Pheromones
+        size_t                          NextId;
+        size_t                          TreeUpdates;    // removals since the trees were last rebuilt
+
+        vector<DecayGroup>              DecayGroups;
+
+        priority_queue<Expiry, vector<Expiry>, greater<Expiry> >  ExpiryHeap;
+};
+
+#endif
@@ -0,0 +1,41 @@
+#include "PoissonTable.h"
+
+#include <cmath>
+#include <limits>
+
+PoissonTable::PoissonTable():
+    Lambda(0.0)
+{
+    CDF.assign(1, 1.0);
+}
+
+void PoissonTable::Build(Real lambda){
+    Lambda = lambda;
+    CDF.clear();
+
+    if(lambda <= 0.0){
+        CDF.push_back(1.0);
+        return;
+    }
+
+    Real logLambda = log(lambda);
+    Real sum = 0.0;
+    for(size_t k = 0; ; k++){
+        Real term = exp(-lambda + k * logLambda - lgamma(k + 1.0));
+        sum += term;
+        CDF.push_back(min(sum, 1.0));
+
+        /* past the mode the terms only shrink, stop once they no longer change the sum */
+        if(k >= lambda && (sum >= 1.0 || term <= sum * numeric_limits<Real>::epsilon())){
+            break;
+        }
+    }
+}
+
+Real PoissonTable::Get(size_t k) const {
+    return (k < CDF.size()) ? CDF[k] : CDF.back();
+}
+
+Real PoissonTable::GetRate() const {
+    return Lambda;
+}
@@ -0,0 +1,39 @@
+#ifndef POISSONTABLE_H_
+#define POISSONTABLE_H_
+
+#include <argos3/core/utility/datatypes/datatypes.h>
+#include <vector>
+
+using namespace argos;
+using namespace std;
+
+/**
+ * Lookup table of the Poisson cumulative distribution P(X <= k) for one rate lambda.
+ *
+ * The robots evaluate the CDF at their local resource density every time they reach the
+ * nest, always with the same few rates, so the values are tabulated once per rate. Each
+ * term lambda^i / i! * e^-lambda is computed in log space (lgamma), which neither
+ * overflows for large k nor underflows for large lambda. The table stops once the CDF
+ * has reached 1 in double precision; Get() returns that last value for any larger k.
+ **/
+class PoissonTable {
+
+    public:
+
+        PoissonTable();
+
+        /* tabulate the CDF for 'lambda', a rate <= 0 gives a CDF of 1 everywhere */
+        void Build(Real lambda);
+
+        /* P(X <= k) */
+        Real Get(size_t k) const;
+
+        Real GetRate() const;
+
+    private:
+
+        Real            Lambda;
+        vector<Real>    CDF;    // CDF[k] = P(X <= k)
+};
+
+#endif
@@ -0,0 +1,95 @@
+#include "RABMessage.h"
+#include <cstring>
+
+const size_t RABMessage::LOCATION_SIZE;
+const size_t RABMessage::RESPONSE_HEADER_SIZE;
+const size_t RABMessage::MAX_VOTES;
+
+size_t RABMessage::ResponseSize(size_t numVotes){
+    return RESPONSE_HEADER_SIZE + 2 * numVotes + (numVotes + 7) / 8;
+}
+
+UInt8 RABMessage::GetType(const CByteArray& buf){
+    if(buf.Size() == 0) return EMPTY;
+    return buf[0];
+}
+
+void RABMessage::EncodeLocation(CByteArray& buf, UInt16 sender, const CVector2& position){
+    buf.Clear();
+    buf << UInt8(LOCATION);
+    WriteUInt16(buf, sender);
+    WriteFloat(buf, float(position.GetX()));
+    WriteFloat(buf, float(position.GetY()));
+}
+
+size_t RABMessage::EncodeResponse(CByteArray& buf, UInt16 sender, const vector<Vote>& votes, size_t first, size_t maxSize){
+    size_t n = 0;
+    if(first < votes.size()) n = min(votes.size() - first, MAX_VOTES);
+    while(n > 0 && ResponseSize(n) > maxSize) n--;
+
+    buf.Clear();
+    buf << UInt8(RESPONSE);
+    WriteUInt16(buf, sender);
+    buf << UInt8(n);
+
+    for(size_t k = 0; k < n; k++){
+        WriteUInt16(buf, votes[first + k].Target);
+    }
+
+    for(size_t byte = 0; byte < (n + 7) / 8; byte++){
+        UInt8 bits = 0;
+        for(size_t bit = 0; bit < 8 && byte * 8 + bit < n; bit++){
+            if(votes[first + byte * 8 + bit].Value) bits |= UInt8(1 << bit);
+        }
+        buf << bits;
+    }
+
+    return n;
+}
+
+bool RABMessage::DecodeLocation(const CByteArray& buf, UInt16& sender, CVector2& position){
+    if(GetType(buf) != LOCATION || buf.Size() < LOCATION_SIZE) return false;
+
+    sender = ReadUInt16(buf, 1);
+    position.Set(ReadFloat(buf, 3), ReadFloat(buf, 7));
+    return true;
+}
+
+bool RABMessage::DecodeResponse(const CByteArray& buf, UInt16& sender, vector<Vote>& votes){
+    votes.clear();
+    if(GetType(buf) != RESPONSE || buf.Size() < RESPONSE_HEADER_SIZE) return false;
+
+    size_t n = buf[3];
+    if(buf.Size() < ResponseSize(n)) return false;
+
+    sender = ReadUInt16(buf, 1);
+
+    size_t voteBlock = RESPONSE_HEADER_SIZE + 2 * n;
+    votes.resize(n);
+    for(size_t k = 0; k < n; k++){
+        votes[k].Target = ReadUInt16(buf, RESPONSE_HEADER_SIZE + 2 * k);
+        votes[k].Value = (buf[voteBlock + k / 8] >> (k % 8)) & 1;
+    }
+    return true;
+}
+
+void RABMessage::WriteUInt16(CByteArray& buf, UInt16 value){
+    buf << UInt8(value & 0xFF) << UInt8(value >> 8);
+}
+
+void RABMessage::WriteFloat(CByteArray& buf, float value){
+    UInt32 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    buf << UInt8(bits & 0xFF) << UInt8((bits >> 8) & 0xFF) << UInt8((bits >> 16) & 0xFF) << UInt8(bits >> 24);
+}
+
+UInt16 RABMessage::ReadUInt16(const CByteArray& buf, size_t offset){
+    return UInt16(buf[offset]) | UInt16(buf[offset + 1] << 8);
+}
+
+float RABMessage::ReadFloat(const CByteArray& buf, size_t offset){
+    UInt32 bits = UInt32(buf[offset]) | (UInt32(buf[offset + 1]) << 8) | (UInt32(buf[offset + 2]) << 16) | (UInt32(buf[offset + 3]) << 24);
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
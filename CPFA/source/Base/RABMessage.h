@@ -0,0 +1,68 @@
+#ifndef RABMESSAGE_H_
+#define RABMESSAGE_H_
+
+#include <argos3/core/utility/datatypes/byte_array.h>
+#include <argos3/core/utility/math/vector2.h>
+#include <vector>
+
+using namespace argos;
+using namespace std;
+
+/**
+ * Packed binary format for the fault detection range-and-bearing messages.
+ *
+ * Robots are addressed by their index in the loop functions' controller registry
+ * instead of their string id. All multi-byte fields are little endian.
+ *
+ *  LOCATION:  [type 'b'][UInt16 sender][float32 x][float32 y]
+ *  RESPONSE:  [type 'r'][UInt16 sender][UInt8 n][n x UInt16 target][ceil(n/8) bytes of votes]
+ *
+ * Vote k of a response is bit (k % 8) of byte (k / 8) of the vote block.
+ **/
+class RABMessage {
+
+    public:
+
+        enum MessageType {
+            EMPTY       = 0,    // zero padding / no data received
+            LOCATION    = 'b',
+            RESPONSE    = 'r'
+        };
+
+        struct Vote {
+            UInt16  Target;     // registry index of the robot being voted on
+            bool    Value;      // true if the target's location checked out
+        };
+
+        static const size_t LOCATION_SIZE = 11;
+        static const size_t RESPONSE_HEADER_SIZE = 4;
+        static const size_t MAX_VOTES = 255;
+
+        /* size in bytes of a response carrying 'numVotes' votes */
+        static size_t ResponseSize(size_t numVotes);
+
+        /* the message type is always the first byte */
+        static UInt8 GetType(const CByteArray& buf);
+
+        /* encoders clear 'buf' before writing */
+        static void EncodeLocation(CByteArray& buf, UInt16 sender, const CVector2& position);
+
+        /**
+         * Encode as many votes as fit in 'maxSize' bytes, starting at votes[first].
+         * @return the number of votes written
+         */
+        static size_t EncodeResponse(CByteArray& buf, UInt16 sender, const vector<Vote>& votes, size_t first, size_t maxSize);
+
+        /* decoders return false if the buffer is not a well formed message of that type */
+        static bool DecodeLocation(const CByteArray& buf, UInt16& sender, CVector2& position);
+        static bool DecodeResponse(const CByteArray& buf, UInt16& sender, vector<Vote>& votes);
+
+    private:
+
+        static void WriteUInt16(CByteArray& buf, UInt16 value);
+        static void WriteFloat(CByteArray& buf, float value);
+        static UInt16 ReadUInt16(const CByteArray& buf, size_t offset);
+        static float ReadFloat(const CByteArray& buf, size_t offset);
+};
+
+#endif
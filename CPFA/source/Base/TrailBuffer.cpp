@@ -0,0 +1,53 @@
+#include "TrailBuffer.h"
+
+TrailBuffer::TrailBuffer():
+    Capacity(0),
+    Head(0),
+    Count(0)
+{}
+
+TrailBuffer::TrailBuffer(size_t capacity):
+    Capacity(0),
+    Head(0),
+    Count(0)
+{
+    SetCapacity(capacity);
+}
+
+void TrailBuffer::SetCapacity(size_t capacity){
+    Capacity = capacity;
+    Rays.assign(capacity, CRay3());
+    Colors.assign(capacity, CColor::BLACK);
+    Head = 0;
+    Count = 0;
+}
+
+size_t TrailBuffer::GetCapacity(){
+    return Capacity;
+}
+
+void TrailBuffer::Push(const CRay3& ray, const CColor& color){
+    if(Capacity == 0) return;
+
+    Rays[Head] = ray;
+    Colors[Head] = color;
+    Head = (Head + 1) % Capacity;
+    if(Count < Capacity) Count++;
+}
+
+void TrailBuffer::Clear(){
+    Head = 0;
+    Count = 0;
+}
+
+size_t TrailBuffer::Size(){
+    return Count;
+}
+
+const CRay3& TrailBuffer::GetRay(size_t i){
+    return Rays[(Head + Capacity - Count + i) % Capacity];
+}
+
+const CColor& TrailBuffer::GetColor(size_t i){
+    return Colors[(Head + Capacity - Count + i) % Capacity];
+}
@@ -0,0 +1,45 @@
+#ifndef TRAILBUFFER_H_
+#define TRAILBUFFER_H_
+
+#include <argos3/core/utility/math/ray3.h>
+#include <argos3/core/utility/datatypes/color.h>
+#include <vector>
+
+using namespace argos;
+using namespace std;
+
+/**
+ * Fixed-capacity ring buffer of colored rays used to draw a robot's recent path.
+ *
+ * Once full, every Push() overwrites the oldest ray, so memory stays constant no
+ * matter how long the experiment runs. A capacity of 0 disables recording.
+ **/
+class TrailBuffer {
+
+    public:
+
+        TrailBuffer();
+        TrailBuffer(size_t capacity);
+
+        /* change the capacity, drops all stored rays */
+        void SetCapacity(size_t capacity);
+        size_t GetCapacity();
+
+        void Push(const CRay3& ray, const CColor& color);
+        void Clear();
+
+        /* number of stored rays, index 0 is the oldest */
+        size_t Size();
+        const CRay3& GetRay(size_t i);
+        const CColor& GetColor(size_t i);
+
+    private:
+
+        vector<CRay3>   Rays;
+        vector<CColor>  Colors;
+        size_t          Capacity;
+        size_t          Head;       // slot the next ray is written to
+        size_t          Count;
+};
+
+#endif
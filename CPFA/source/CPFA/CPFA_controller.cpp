@@ -9,9 +9,9 @@ CPFA_controller::CPFA_controller() :
 	isUsingSiteFidelity(false),
 	isGivingUpSearch(false),
 	ResourceDensity(0),
-	MaxTrailSize(50),
 	SearchTime(0),
 	CPFA_state(DEPARTING),
+	robotIndex(0),
 	LoopFunctions(NULL),
 	survey_count(0),
 	isUsingPheromone(0),
@@ -26,8 +26,12 @@ CPFA_controller::CPFA_controller() :
 	FFdetectionAcc(0.0),
 	RFdetectionAcc(0.0),
 	faultInjected(false),
+	voteCount(0),
+	trueVotes(0),
+	falseVotes(0),
 	faultDetected(false),
-	faultLogged(false)
+	faultLogged(false),
+	responseSent(0)
 {
 }
 
@@ -119,6 +123,9 @@ void CPFA_controller::RemoveLocalFood(Food F){
 
 void CPFA_controller::ControlStep() {
 
+	// read the sensors once, the rest of the step uses the snapshot
+	UpdateSensorSnapshot();
+
 	#pragma region Draw Trails
 
 	// Add line so we can draw the trail
@@ -127,23 +134,22 @@ void CPFA_controller::ControlStep() {
 	 * MODIFIED: Use the true position of the robot to draw trail, not the robot's estimated position (potenetially faulty)
 	*/
 
-	CVector3 position3d(GetRealPosition().GetX(), GetRealPosition().GetY(), 0.00);
-	CVector3 target3d(previous_position.GetX(), previous_position.GetY(), 0.00);
-	CRay3 targetRay(target3d, position3d);
-	myTrail.push_back(targetRay);
-	LoopFunctions->TargetRayList.push_back(targetRay);
-	LoopFunctions->TargetRayColorList.push_back(TrailColor);
+	if (!LoopFunctions->Headless){
+		CVector3 position3d(GetRealPosition().GetX(), GetRealPosition().GetY(), 0.00);
+		CVector3 target3d(previous_position.GetX(), previous_position.GetY(), 0.00);
+		CRay3 targetRay(target3d, position3d);
+		myTrail.Push(targetRay, TrailColor);
 
-	previous_position = GetRealPosition();
+		previous_position = GetRealPosition();
+	}
 
 	#pragma endregion
 
 	// check if the vote cap has been reached
-	if (voterIDs.size() >= LoopFunctions->VoteCap){
+	if (voteCount >= LoopFunctions->VoteCap){
 		// process votes
 		// if (controllerID == "fb00") LOG << "fboo processing votes. Time:" << LoopFunctions->getSimTimeInSeconds() << endl;
 		ProcessVotes();
-		voterIDs.clear();
 	}
 	if (faultDetected && !faultLogged){
 		stringstream ssLog;
@@ -186,7 +192,7 @@ void CPFA_controller::ControlStep() {
 	// 		} else if (!responseQueue.empty()){	
 	// 			if (controllerID == "fb00") LOG << "fb00 broadcasting response," << setw(setwidth) << right << "Time:" << LoopFunctions->getSimTimeInSeconds() << endl;
 	// 			BroadcastTargetedResponse();
-	// 			// if (controllerID == "fb00") LOG << "fb00 broadcast response. " << ", Voter list size: " << voterIDs.size() << endl;
+	// 			// if (controllerID == "fb00") LOG << "fb00 broadcast response. " << ", Voter list size: " << voteCount << endl;
 	// 		}
 	// 	}
 	// }
@@ -233,9 +239,21 @@ void CPFA_controller::Reset() {
     updateFidelity = false;
     TrailToShare.clear();
     TrailToFollow.clear();
-    	MyTrail.clear();
 
-	myTrail.clear();
+	myTrail.Clear();
+	Intents.Clear();
+
+	responseQueue.clear();
+	responseSent = 0;
+	ClearVotes();
+
+	ClearFault();
+	InvalidateSensorSnapshot();
+	faultInjected = false;
+	faultDetected = false;
+	faultLogged = false;
+	broadcastProcessed = false;
+	responseProcessed = false;
 
 	isInformed = false;
 	isHoldingFood = false;
@@ -308,6 +326,15 @@ bool CPFA_controller::ActuallyIsInTheNest() {
 void CPFA_controller::SetLoopFunctions(CPFA_loop_functions* lf) {
 	LoopFunctions = lf;
 
+	// the movement timing uses the clock rate the loop functions resolved
+	SetClockTick(LoopFunctions->TicksPerSecond);
+
+	// one "has voted" bit per robot in the swarm
+	hasVoted.assign(LoopFunctions->getNumberOfRobots(), false);
+	ClearVotes();
+
+	UpdateTrailCapacity();
+
 	// Initialize the SiteFidelityPosition
 
 	// Create the output file here because it needs LoopFunctions
@@ -474,8 +501,8 @@ void CPFA_controller::Searching() {
 	if((SimulationTick() % (SimulationTicksPerSecond() / 2)) == 0) {
 		SetHoldingFood();
 	}
-	// When not carrying food, calculate movement.
-	if(IsHoldingFood() == false) {
+	// When not carrying food (or waiting for a claimed one), calculate movement.
+	if(IsHoldingFood() == false && !Intents.PickupClaimed) {
 		argos::CVector2 distance = GetPosition() - GetTarget();
 		argos::Real     random   = RNG->Uniform(argos::CRange<argos::Real>(0.0, 1.0));
      
@@ -491,7 +518,7 @@ void CPFA_controller::Searching() {
 				SetIsHeadingToNest(true);
 				SetTarget(LoopFunctions->NestPosition);
 				isGivingUpSearch = true;
-				LoopFunctions->FidelityList.erase(controllerID);
+				Intents.Fidelity = WorldIntents::FIDELITY_ERASE;
 				isUsingSiteFidelity = false; 
 				updateFidelity = false; 
 				CPFA_state = RETURNING;
@@ -636,8 +663,8 @@ void CPFA_controller::Returning() {
 
 			// Based on a Poisson CDF, the robot may or may not create a pheromone
 			// located at the last place it picked up food.
-			argos::Real poissonCDF_pLayRate    = GetPoissonCDF(ResourceDensity, LoopFunctions->RateOfLayingPheromone);
-			argos::Real poissonCDF_sFollowRate = GetPoissonCDF(ResourceDensity, LoopFunctions->RateOfSiteFidelity);
+			argos::Real poissonCDF_pLayRate    = LoopFunctions->LayingPheromoneCDF.Get(ResourceDensity);
+			argos::Real poissonCDF_sFollowRate = LoopFunctions->SiteFidelityCDF.Get(ResourceDensity);
 			argos::Real r1 = RNG->Uniform(argos::CRange<argos::Real>(0.0, 1.0));
 			argos::Real r2 = RNG->Uniform(argos::CRange<argos::Real>(0.0, 1.0));
 			
@@ -660,10 +687,7 @@ void CPFA_controller::Returning() {
 				// only count it if the food is real ** Ryan Luna 11/12/22
 				if (!isHoldingFakeFood){	// IF HOLDING REAL FOOD
 
-					num_targets_collected++;
-					LoopFunctions->currNumCollectedFood++;
-					LoopFunctions->RealFoodCollected++;
-					LoopFunctions->setScore(num_targets_collected);
+					Intents.RealCollected++;
 					// delete local food list		Ryan Luna 01/24/23
 					ClearLocalFoodList();
 
@@ -673,12 +697,12 @@ void CPFA_controller::Returning() {
 					 * Ryan Luna 01/25/23
 					*/
 					if(poissonCDF_pLayRate > r1 && updateFidelity) {
-						LoopFunctions->numRealTrails++;
+						Intents.RealTrails++;
 						TrailToShare.push_back(SiteFidelityPosition);	// moved from SetLocalResourseDensity() Ryan Luna 02/05/23
 						TrailToShare.push_back(LoopFunctions->NestPosition); //qilu 07/26/2016
 						argos::Real timeInSeconds = (argos::Real)(SimulationTick() / SimulationTicksPerSecond());
 						Pheromone sharedPheromone(SiteFidelityPosition, TrailToShare, timeInSeconds, LoopFunctions->RateOfPheromoneDecay, ResourceDensity, isHoldingFakeFood);
-						LoopFunctions->PheromoneList.push_back(sharedPheromone);
+						Intents.Pheromones.push_back(sharedPheromone);
 						sharedPheromone.Deactivate(); // make sure this won't get re-added later...
 					}
 					TrailToShare.clear(); 
@@ -713,7 +737,7 @@ void CPFA_controller::Returning() {
 						// 		TrailToShare.push_back(LoopFunctions->NestPosition); //qilu 07/26/2016
 						// 		argos::Real timeInSeconds = (argos::Real)(SimulationTick() / SimulationTicksPerSecond());
 						// 		Pheromone sharedPheromone(SiteFidelityPosition, TrailToShare, timeInSeconds, LoopFunctions->RateOfPheromoneDecay, ResourceDensity, isHoldingFakeFood);
-						// 		LoopFunctions->PheromoneList.push_back(sharedPheromone);
+						// 		LoopFunctions->PheromoneList.Add(sharedPheromone);
 						// 		sharedPheromone.Deactivate(); // make sure this won't get re-added later...
 						// 	}
 						// 	TrailToShare.clear(); 
@@ -722,7 +746,7 @@ void CPFA_controller::Returning() {
 					}
 				} else {	// IF HOLDING FAKE FOOD
 
-					LoopFunctions->FakeFoodCollected++;
+					Intents.FakeCollected++;
 					// the nest will detect fake food with <FFdetectionAcc> accuracy.
 					Real random = RNG->Uniform(CRange<Real>(0.0, 1.0));
 					if (random <= FFdetectionAcc){	// Passed fake food detection probability
@@ -731,7 +755,10 @@ void CPFA_controller::Returning() {
 						if (!LocalFoodList.empty() && UseQZones){	// IF THE LOCAL FOOD LIST IS NOT EMPTY
 
 							// give local food info to nest to create a quarantine zone		Ryan Luna 01/24/23
-							LoopFunctions->MainNest.CreateZone(MergeMode, LoopFunctions->FoodList, LocalFoodList, FoodBeingHeld, LoopFunctions->SearchRadius);
+							// (the zone is created in PostStep, so this robot learns about it on its next visit)
+							Intents.ReportZone = true;
+							Intents.ZoneFood = LocalFoodList;
+							Intents.ZoneCenter = FoodBeingHeld;
 							ClearLocalFoodList();
 							// possible unsafe usage of FoodBeingHeld (unsure how to clean object memory without destroying it)		// Ryan Luna 01/25/23
 						}
@@ -742,19 +769,19 @@ void CPFA_controller::Returning() {
 							 * Ryan Luna 02/5/23
 							*/
 							if(poissonCDF_pLayRate > r1 && updateFidelity) {
-								LoopFunctions->numFakeTrails++;
+								Intents.FakeTrails++;
 								TrailToShare.push_back(SiteFidelityPosition);
 								TrailToShare.push_back(LoopFunctions->NestPosition); //qilu 07/26/2016
 								argos::Real timeInSeconds = (argos::Real)(SimulationTick() / SimulationTicksPerSecond());
 								Pheromone sharedPheromone(SiteFidelityPosition, TrailToShare, timeInSeconds, LoopFunctions->RateOfPheromoneDecay, ResourceDensity, isHoldingFakeFood);
-								LoopFunctions->PheromoneList.push_back(sharedPheromone);
+								Intents.Pheromones.push_back(sharedPheromone);
 								sharedPheromone.Deactivate(); // make sure this won't get re-added later...
 							}
 							TrailToShare.clear(); 
 						}
 					} else { // TREAT IT AS REAL FOOD
 						LOG << "False Positive Collected..." << endl;
-						LoopFunctions->numFalsePositives++;		// increment number of false positives on real food detected
+						Intents.FalsePositives++;		// increment number of false positives on real food detected
 						//argos::LOG << "Real Food Aquired" << endl;
 						// num_targets_collected++;
 						// LoopFunctions->currNumCollectedFood++;
@@ -770,12 +797,12 @@ void CPFA_controller::Returning() {
 						 * Ryan Luna 01/25/23
 						*/
 						if(poissonCDF_pLayRate > r1 && updateFidelity) {
-							LoopFunctions->numFakeTrails++;
+							Intents.FakeTrails++;
 							TrailToShare.push_back(SiteFidelityPosition);	// moved from SetLocalResourseDensity() Ryan Luna 02/05/23
 							TrailToShare.push_back(LoopFunctions->NestPosition); //qilu 07/26/2016
 							argos::Real timeInSeconds = (argos::Real)(SimulationTick() / SimulationTicksPerSecond());
 							Pheromone sharedPheromone(SiteFidelityPosition, TrailToShare, timeInSeconds, LoopFunctions->RateOfPheromoneDecay, ResourceDensity, isHoldingFakeFood);
-							LoopFunctions->PheromoneList.push_back(sharedPheromone);
+							Intents.Pheromones.push_back(sharedPheromone);
 							sharedPheromone.Deactivate(); // make sure this won't get re-added later...
 						}
 						TrailToShare.clear(); 
@@ -924,95 +951,118 @@ bool CPFA_controller::TargetInQZone(CVector2 target){
 /*****
  * Check if the iAnt is finding food. This is defined as the iAnt being within
  * the distance tolerance of the position of a food item. If the iAnt has found
- * food then the appropriate boolean flags are triggered.
+ * food it claims it; the loop functions hand the food over in PostStep through
+ * CompletePickup(), unless another robot claimed it in the same tick.
  *****/
 void CPFA_controller::SetHoldingFood() {
 	// Is the iAnt already holding food?
-	if(IsHoldingFood() == false) {
+	if(IsHoldingFood() == false && !Intents.PickupClaimed) {
 		// No, the iAnt isn't holding food. Check if we have found food at our
-		// current position and update the food list if we have.
-		size_t i = 0, j = 0;
-
-		for(i = 0; i < LoopFunctions->FoodList.size(); i++) {
-			if((GetRealPosition() - LoopFunctions->FoodList[i].GetLocation()).SquareLength() < FoodDistanceTolerance ) {
-				// We found food!
-				// Now check if this food is in Quarantine Zone (if QZoneStrategy is ON)	// Ryan Luna 01/25/23
-				bool badFood = false;
-				if (UseQZones){
-					for (QZone qz : QZoneList){
-						for (Food f : qz.GetFoodList()){
-							if (f.GetLocation()==LoopFunctions->FoodList[i].GetLocation()){	// bad food found
-								badFood = true;
-
-								/**
-								 * If we don't have a CurrentZone set, set it
-								 * 
-								 * Else if the zone we are in matches the CurrentZone we have set,
-								 * Increment the BadFoodCount and check if the limit is reached,
-								 * If so, return to the nest
-								 * 
-								 * Else, we are in a new zone that doesn't match our previous CurrentZone,
-								 * reset the BadFoodCount and set CurrentZone to this new zone we are in
-								*/
-
-								if (CurrentZone == NULL){
-									CurrentZone = &qz;
-									BadFoodCount++;
-								} else if (CurrentZone == &qz){
-									BadFoodCount++;
-									if (BadFoodCount >= BadFoodLimit){
-										SetFidelityList();
-										TrailToShare.clear();
-										SetIsHeadingToNest(true);
-										SetTarget(LoopFunctions->NestPosition);
-										isGivingUpSearch = true;
-										LoopFunctions->FidelityList.erase(controllerID);
-										isUsingSiteFidelity = false; 
-										updateFidelity = false; 
-										CPFA_state = RETURNING;
-										searchingTime+=SimulationTick()-startTime;
-										startTime = SimulationTick();
-									}
-								} else {
-									BadFoodCount = 0;
-									CurrentZone = &qz;
+		// current position and claim it if we have.
+		size_t i = 0;
+
+		// only the food within reach is returned by the index, visit it in FoodList order
+		NearbyFood.clear();
+		LoopFunctions->FoodIndex.Query(GetRealPosition(), sqrt(FoodDistanceTolerance), LoopFunctions->FoodList, NearbyFood);
+		sort(NearbyFood.begin(), NearbyFood.end());
+
+		for(size_t n = 0; n < NearbyFood.size(); n++) {
+			i = NearbyFood[n];
+			// We found food!
+			// Now check if this food is in Quarantine Zone (if QZoneStrategy is ON)	// Ryan Luna 01/25/23
+			bool badFood = false;
+			if (UseQZones){
+				for (QZone qz : QZoneList){
+					for (Food f : qz.GetFoodList()){
+						if (f.GetLocation()==LoopFunctions->FoodList[i].GetLocation()){	// bad food found
+							badFood = true;
+
+							/**
+							 * If we don't have a CurrentZone set, set it
+							 * 
+							 * Else if the zone we are in matches the CurrentZone we have set,
+							 * Increment the BadFoodCount and check if the limit is reached,
+							 * If so, return to the nest
+							 * 
+							 * Else, we are in a new zone that doesn't match our previous CurrentZone,
+							 * reset the BadFoodCount and set CurrentZone to this new zone we are in
+							*/
+
+							if (CurrentZone == NULL){
+								CurrentZone = &qz;
+								BadFoodCount++;
+							} else if (CurrentZone == &qz){
+								BadFoodCount++;
+								if (BadFoodCount >= BadFoodLimit){
+									SetFidelityList();
+									TrailToShare.clear();
+									SetIsHeadingToNest(true);
+									SetTarget(LoopFunctions->NestPosition);
+									isGivingUpSearch = true;
+									Intents.Fidelity = WorldIntents::FIDELITY_ERASE;
+									isUsingSiteFidelity = false; 
+									updateFidelity = false; 
+									CPFA_state = RETURNING;
+									searchingTime+=SimulationTick()-startTime;
+									startTime = SimulationTick();
 								}
-								
-								break;
+							} else {
+								BadFoodCount = 0;
+								CurrentZone = &qz;
 							}
+							
+							break;
 						}
-						if (badFood){break;}
-					}
-				}
-				if (!badFood){	// IF THE FOOD IS NOT IN QZONE THEN PROCEED 
-					isHoldingFood = true;
-					// Update food variable		// Ryan Luna 1/24/23
-					FoodBeingHeld = LoopFunctions->FoodList[i];
-					// Check if the food is fake
-					if (LoopFunctions->FoodList[i].GetType() == Food::FAKE){	// Ryan Luna 11/12/22
-						isHoldingFakeFood = true;
 					}
-					CPFA_state = SURVEYING;
-					j = i + 1;
-					searchingTime+=SimulationTick()-startTime;
-					startTime = SimulationTick();
-					break;
+					if (badFood){break;}
 				}
 			}
-		}
-		// We picked up food. Erase the food we picked up from the food list. ** Ryan Luna 11/11/22
-		if(IsHoldingFood()){
-			LoopFunctions->FoodList.erase(LoopFunctions->FoodList.begin() + i);
-			SetLocalResourceDensity();
+			if (!badFood){	// IF THE FOOD IS NOT IN QZONE THEN PROCEED 
+				Intents.PickupClaimed = true;
+				Intents.PickupFood = i;
+				break;
+			}
 		}
 	}
 		
 }
 
+/*****
+ * Called by the loop functions in PostStep when our pickup claim was granted. The food has
+ * already been erased from the food list. ** Ryan Luna 11/11/22
+ *****/
+void CPFA_controller::CompletePickup(Food food) {
+	Intents.PickupClaimed = false;
+
+	isHoldingFood = true;
+	// Update food variable		// Ryan Luna 1/24/23
+	FoodBeingHeld = food;
+	// Check if the food is fake
+	if (food.GetType() == Food::FAKE){	// Ryan Luna 11/12/22
+		isHoldingFakeFood = true;
+	}
+	CPFA_state = SURVEYING;
+	searchingTime+=SimulationTick()-startTime;
+	startTime = SimulationTick();
+
+	SetLocalResourceDensity();
+}
+
+/* another robot claimed the same food this tick, keep searching */
+void CPFA_controller::RejectPickup() {
+	Intents.PickupClaimed = false;
+}
+
+bool CPFA_controller::GetPickupClaim(size_t& foodIdx) {
+	foodIdx = Intents.PickupFood;
+	return Intents.PickupClaimed;
+}
+
 /*****
  * If the robot has just picked up a food item, this function will be called
  * so that the food density in the local region is analyzed and saved. This
- * helps facilitate calculations for pheromone laying.
+ * helps facilitate calculations for pheromone laying. It runs from CompletePickup(),
+ * i.e. in PostStep, so it may recolor the food list directly.
  *
  * Ideally, given that: [*] is food, and [=] is a robot
  *
@@ -1025,8 +1075,6 @@ void CPFA_controller::SetHoldingFood() {
  * item detection is based on distance calculations with circles.
  *****/
 void CPFA_controller::SetLocalResourceDensity() {
-	argos::CVector2 distance;
-
 	// remember: the food we picked up is removed from the foodList before this function call
 	// therefore compensate here by counting that food (which we want to count)
 	ResourceDensity = 1;
@@ -1039,19 +1087,24 @@ void CPFA_controller::SetLocalResourceDensity() {
 	 * EXPLANATION: Here we are simulating the use of sensors to calculate resource density in the local region. 
 	 * 				We must use the true position and not the potentially faulty position the robot thinks it is in.
 	*/
-	for(size_t i = 0; i < LoopFunctions->FoodList.size(); i++) {
-		distance = GetRealPosition() - LoopFunctions->FoodList[i].GetLocation();	// modified ** Ryan Luna 11/11/22
+	NearbyFood.clear();
+	LoopFunctions->FoodIndex.Query(GetRealPosition(), sqrt(LoopFunctions->SearchRadiusSquared*2), LoopFunctions->FoodList, NearbyFood);	// modified ** Ryan Luna 11/11/22
+	sort(NearbyFood.begin(), NearbyFood.end());
+
+	for(size_t n = 0; n < NearbyFood.size(); n++) {
+		size_t i = NearbyFood[n];
 
 		// Local food found
-		if(distance.SquareLength() < LoopFunctions->SearchRadiusSquared*2) {
-			ResourceDensity++;
+		ResourceDensity++;
+		if (!LoopFunctions->Headless){
 			LoopFunctions->FoodList[i].SetColor(argos::CColor::ORANGE);	// modified ** Ryan Luna 11/11/22
 			LoopFunctions->ResourceDensityDelay = SimulationTick() + SimulationTicksPerSecond() * 10;
+			LoopFunctions->FoodColorsDirty = true;
+		}
 
-			// Add to lcoal food list to give to nest 		// Ryan Luna 01/24/23
-			if (UseQZones){
-				AddLocalFood(LoopFunctions->FoodList[i]);
-			}
+		// Add to lcoal food list to give to nest 		// Ryan Luna 01/24/23
+		if (UseQZones){
+			AddLocalFood(LoopFunctions->FoodList[i]);
 		}
 	}
  
@@ -1064,7 +1117,8 @@ void CPFA_controller::SetLocalResourceDensity() {
     isUsingSiteFidelity = true;
     updateFidelity = true; 
     // TrailToShare.push_back(SiteFidelityPosition);  // *pheromone waypoint bug fix* -- moved to Returning() -- Ryan Luna 02/25/23
-    LoopFunctions->FidelityList[controllerID] = SiteFidelityPosition;
+    Intents.Fidelity = WorldIntents::FIDELITY_SET;
+    Intents.FidelityPosition = SiteFidelityPosition;
 }
 
 /*****
@@ -1084,7 +1138,8 @@ void CPFA_controller::SetFidelityList(argos::CVector2 newFidelity) {
 	/* Update the global fidelity list. */
 	//LoopFunctions->FidelityList = newFidelityList;
 
-        LoopFunctions->FidelityList[controllerID] = newFidelity;
+        Intents.Fidelity = WorldIntents::FIDELITY_SET;
+        Intents.FidelityPosition = newFidelity;
 	/* Add the robot's new fidelity position to the global fidelity list. */
 	//LoopFunctions->FidelityList.push_back(newFidelity);
  
@@ -1103,55 +1158,96 @@ void CPFA_controller::SetFidelityList() {
 
 	/* Remove this robot's old fidelity position from the fidelity list. */
 	/* Update the global fidelity list. */
-        LoopFunctions->FidelityList.erase(controllerID);
+        Intents.Fidelity = WorldIntents::FIDELITY_ERASE;
  SiteFidelityPosition = CVector2(10000, 10000);
  updateFidelity = true; 
 }
 
+CPFA_controller::WorldIntents::WorldIntents()
+{
+	Clear();
+}
+
+void CPFA_controller::WorldIntents::Clear() {
+	PickupClaimed = false;
+	PickupFood = 0;
+	Fidelity = FIDELITY_KEEP;
+	Pheromones.clear();
+	ReportZone = false;
+	ZoneFood.clear();
+	RealCollected = 0;
+	FakeCollected = 0;
+	RealTrails = 0;
+	FakeTrails = 0;
+	FalsePositives = 0;
+}
+
+/*****
+ * Apply the intents recorded during this tick's ControlStep() to the loop functions.
+ * Called from CPFA_loop_functions::PostStep, one robot at a time in robot index order,
+ * after the pickup claims have been resolved.
+ *****/
+void CPFA_controller::ApplyIntents() {
+	for(size_t i = 0; i < Intents.RealCollected; i++) {
+		num_targets_collected++;
+		LoopFunctions->currNumCollectedFood++;
+		LoopFunctions->RealFoodCollected++;
+		LoopFunctions->setScore(num_targets_collected);
+	}
+	LoopFunctions->FakeFoodCollected += Intents.FakeCollected;
+	LoopFunctions->numRealTrails += Intents.RealTrails;
+	LoopFunctions->numFakeTrails += Intents.FakeTrails;
+	LoopFunctions->numFalsePositives += Intents.FalsePositives;
+
+	for(size_t i = 0; i < Intents.Pheromones.size(); i++) {
+		LoopFunctions->PheromoneList.Add(Intents.Pheromones[i]);
+	}
+
+	if(Intents.Fidelity == WorldIntents::FIDELITY_SET) {
+		LoopFunctions->FidelityList[controllerID] = Intents.FidelityPosition;
+	} else if(Intents.Fidelity == WorldIntents::FIDELITY_ERASE) {
+		LoopFunctions->FidelityList.erase(controllerID);
+	}
+
+	if(Intents.ReportZone) {
+		LoopFunctions->MainNest.CreateZone(MergeMode, LoopFunctions->FoodList, LoopFunctions->FoodIndex, Intents.ZoneFood, Intents.ZoneCenter, LoopFunctions->SearchRadius);
+	}
+
+	Intents.Clear();
+}
+
 /*****
  * Update the pheromone list and set the target to a pheromone position.
  * return TRUE:  pheromone was successfully targeted
  *        FALSE: pheromones don't exist or are all inactive
  *****/
 bool CPFA_controller::SetTargetPheromone() {
-	argos::Real maxStrength = 0.0, randomWeight = 0.0;
+	argos::Real randomWeight = 0.0;
 	bool isPheromoneSet = false;
+	argos::Real timeInSeconds = (argos::Real)SimulationTick() / SimulationTicksPerSecond();
+	size_t i = 0;
 
- 	if(LoopFunctions->PheromoneList.size()==0) return isPheromoneSet; //the case of no pheromone.
-	/* update the pheromone list and remove inactive pheromones */
+ 	if(LoopFunctions->PheromoneList.Size()==0) return isPheromoneSet; //the case of no pheromone.
 
 	/* default target = nest; in case we have 0 active pheromones */
 	//SetIsHeadingToNest(true);
 	//SetTarget(LoopFunctions->NestPosition);
-	/* Calculate a maximum strength based on active pheromone weights. */
-	for(size_t i = 0; i < LoopFunctions->PheromoneList.size(); i++) {
-		if(LoopFunctions->PheromoneList[i].IsActive()) {
-			maxStrength += LoopFunctions->PheromoneList[i].GetWeight();
-		}
-	}
 
-	/* Calculate a random weight. */
-	randomWeight = RNG->Uniform(argos::CRange<argos::Real>(0.0, maxStrength));
-
-	/* Randomly select an active pheromone to follow. */
-	for(size_t i = 0; i < LoopFunctions->PheromoneList.size(); i++) {
-		   if(randomWeight < LoopFunctions->PheromoneList[i].GetWeight()) {
-			       /* We've chosen a pheromone! */
-			       SetIsHeadingToNest(false);
-          SetTarget(LoopFunctions->PheromoneList[i].GetLocation());
-          TrailToFollow = LoopFunctions->PheromoneList[i].GetTrail();
-          isPheromoneSet = true;
-          /* If we pick a pheromone, break out of this loop. */
-          break;
-     }
-
-     /* We didn't pick a pheromone! Remove its weight from randomWeight. */
-     randomWeight -= LoopFunctions->PheromoneList[i].GetWeight();
+	/* Calculate a random weight, as a fraction of the total strength of the active pheromones. */
+	randomWeight = RNG->Uniform(argos::CRange<argos::Real>(0.0, 1.0));
+
+	/* Randomly select an active pheromone to follow (weighted by strength, see PheromoneStore::Sample). */
+	if(LoopFunctions->PheromoneList.Sample(timeInSeconds, randomWeight, i)) {
+		/* We've chosen a pheromone! */
+		SetIsHeadingToNest(false);
+		SetTarget(LoopFunctions->PheromoneList[i].GetLocation());
+		TrailToFollow = LoopFunctions->PheromoneList[i].GetTrail();
+		isPheromoneSet = true;
 	}
 
 	//ofstream log_output_stream;
 	//log_output_stream.open("cpfa_log.txt", ios::app);
-	//log_output_stream << "Found: " << LoopFunctions->PheromoneList.size()  << " waypoints." << endl;
+	//log_output_stream << "Found: " << LoopFunctions->PheromoneList.Size()  << " waypoints." << endl;
 	//log_output_stream << "Follow waypoint?: " << isPheromoneSet << endl;
 	//log_output_stream.close();
 
@@ -1212,23 +1308,8 @@ string CPFA_controller::GetStatus(){//qilu 10/22
     
 }
 
-/*****
- * Return the Poisson cumulative probability at a given k and lambda.
- *****/
-argos::Real CPFA_controller::GetPoissonCDF(argos::Real k, argos::Real lambda) {
-	argos::Real sumAccumulator       = 1.0;
-	argos::Real factorialAccumulator = 1.0;
-
-	for (size_t i = 1; i <= floor(k); i++) {
-		factorialAccumulator *= i;
-		sumAccumulator += pow(lambda, i) / factorialAccumulator;
-	}
-
-	return (exp(-lambda) * sumAccumulator);
-}
-
 void CPFA_controller::UpdateTargetRayList() {
-	if(SimulationTick() % LoopFunctions->DrawDensityRate == 0 && LoopFunctions->DrawTargetRays == 1) {
+	if(!LoopFunctions->Headless && SimulationTick() % LoopFunctions->DrawDensityRate == 0 && LoopFunctions->DrawTargetRays == 1) {
 
 		/**
 		 * MODIFIED: Must use the robot's true position. This function is used for visualization only.
@@ -1243,20 +1324,10 @@ void CPFA_controller::UpdateTargetRayList() {
 		/* scale the target ray to be <= searchStepSize */
 		argos::Real length = std::abs(t.Length() - p.Length());
 
-		if(length > SearchStepSize) {
-			MyTrail.clear();
-		} else {
+		if(length <= SearchStepSize) {
 			/* add the ray to the robot's target trail */
 			argos::CRay3 targetRay(target3d, position3d);
-			MyTrail.push_back(targetRay);
-
-			/* delete the oldest ray from the trail */
-			if(MyTrail.size() > MaxTrailSize) {
-				MyTrail.erase(MyTrail.begin());
-			}
-
-			LoopFunctions->TargetRayList.insert(LoopFunctions->TargetRayList.end(), MyTrail.begin(), MyTrail.end());
-			// loopFunctions.TargetRayList.push_back(myTrail);
+			myTrail.Push(targetRay, TrailColor);
 		}
 	}
 }
@@ -1264,81 +1335,64 @@ void CPFA_controller::UpdateTargetRayList() {
 
 /**
  * Broadcast the location of the robot to all other robots.
- * Format of message: <message_type>,<id>,<x_value>,<y_value>
- * e.g. "b,fb01,1,2"
+ * The message is a RABMessage::LOCATION packet carrying our registry index and (possibly faulted) position.
 */
 void CPFA_controller::BroadcastLocation(){
-	string selfID = controllerID;
-
-	ostringstream ossPos;
-	ossPos << fixed << setprecision(3) << GetPosition().GetX() << "," << GetPosition().GetY();
-
-	string selfPos = ossPos.str();
-
-	Broadcast("b," + selfID + "," + selfPos);
+	RABMessage::EncodeLocation(msgBuf, robotIndex, GetPosition());
+	Broadcast(msgBuf);
 }
 
 void CPFA_controller::ProcessMessages(char mode){
-	vector<tuple<string, Real, CRadians>> msgQueue = Receive();
+	const CCI_RangeAndBearingSensor::TReadings& msgQueue = Receive();
 	// LOG << LoopFunctions->getSimTimeInSeconds() << endl;
 
 	for(auto it = msgQueue.begin(); it != msgQueue.end(); ++it) {
 
 		// process message (the message should always begin with the message type)
-		stringstream ss(get<0>(*it));
-		// LOG << "converted: " << ss.str() << endl;
-		string msgType;
-		getline(ss, msgType, ',');
+		UInt8 msgType = RABMessage::GetType(it->Data);
 
-		// if (controllerID == "fb00") LOG << "fb00 received: " << ss.str() << setw(setwidth) << right << "Time: " << LoopFunctions->getSimTimeInSeconds() << endl;
 		if (mode == 'b'){
-			if (msgType == "r"){ 
+			if (msgType == RABMessage::RESPONSE){ 
 				// LOG << "WARNING: received response type message during broadcast mode in ProcessMessages()" << endl;
-			} else if (msgType == "b"){
-				string senderID, x_str, y_str;
-				getline(ss, senderID, ',');
-				getline(ss, x_str, ',');
-				getline(ss, y_str, ',');
-				CVector2 senderEstPos(stod(x_str), stod(y_str)); 	// position given by the sender (possibly faulted)
-				Real signalRange = get<1>(*it);						// range of signal provided by RAB Sensor
-				CRadians signalBearing = get<2>(*it);				// bearing of signal provided by RAB Sensor
-				// if (controllerID == "fb00") LOG << "fb00 received broadast: " << ss.str() << setw(setwidth) << right << "Time: " << LoopFunctions->getSimTimeInSeconds() << endl;
-				responseQueue.push(make_pair(senderID, LocalizationCheck(senderEstPos, signalRange, signalBearing, senderID)));
+			} else if (msgType == RABMessage::LOCATION){
+				UInt16 senderIndex;
+				CVector2 senderEstPos;								// position given by the sender (possibly faulted)
+				if (!RABMessage::DecodeLocation(it->Data, senderIndex, senderEstPos)) continue;
+				Real signalRange = it->Range;						// range of signal provided by RAB Sensor
+				CRadians signalBearing = it->HorizontalBearing;		// bearing of signal provided by RAB Sensor
+				RABMessage::Vote v;
+				v.Target = senderIndex;
+				v.Value = LocalizationCheck(senderEstPos, signalRange, signalBearing, senderIndex);
+				responseQueue.push_back(v);
 				broadcastProcessed = true;
 			}
-			else if (ss.eof()){
+			else if (msgType == RABMessage::EMPTY){
 				if (controllerID == "fb00") LOG << "fb00 received EOF" << setw(setwidth) << right << "Time: " << LoopFunctions->getSimTimeInSeconds() << endl;
 			} else {
-				LOG << "runtime_error: " << msgType << endl;
+				LOG << "runtime_error: " << int(msgType) << endl;
 				// throw runtime_error("Runtime Error: " + msgType + "is not a valid message type...\n");
 			}
 		} else if (mode == 'r'){
-			if (msgType == "b") LOG << "WARNING: received broadcast type message during response mode in ProcessMessages()" << endl;
-			else if (msgType == "r"){
-				// if (controllerID == "fb00") LOG << "fb00 received response" << setw(setwidth) << right << "Time: " << LoopFunctions->getSimTimeInSeconds() << endl;
-				// else LOG << controllerID << " received response" << setw(setwidth) << right << "Time: " << LoopFunctions->getSimTimeInSeconds() << endl;
-				while (!ss.eof()){
-					string targetID, senderID, f_str;
-					getline(ss, targetID, ',');
-					getline(ss, senderID, ',');
-					getline(ss, f_str, ',');
-					
-					// check if the message is for this bot and make sure the sender hasn't already voted
-					if (controllerID == targetID && voterIDs.find(senderID) == voterIDs.end()){
-						
-						bool faulty = stoi(f_str);		// fault boolean
-						voteQueue.push_back(faulty);	// store vote
-						voterIDs.insert(senderID);		// store voter ID
-
-						// if (controllerID == "fb00") LOG << "fb00 responseLogged set to True" << setw(setwidth) << right << "Time: " << LoopFunctions->getSimTimeInSeconds() << endl;
+			if (msgType == RABMessage::LOCATION) LOG << "WARNING: received broadcast type message during response mode in ProcessMessages()" << endl;
+			else if (msgType == RABMessage::RESPONSE){
+				UInt16 senderIndex;
+				if (!RABMessage::DecodeResponse(it->Data, senderIndex, receivedVotes)) continue;
+
+				for (size_t k = 0; k < receivedVotes.size(); k++){
+					// check if the vote is for this bot and make sure the sender hasn't already voted
+					if (receivedVotes[k].Target == robotIndex && senderIndex < hasVoted.size() && !hasVoted[senderIndex]){
+						if (receivedVotes[k].Value) trueVotes++;	// store vote
+						else falseVotes++;
+						voteCount++;
+						hasVoted[senderIndex] = true;				// store voter index
 					}
 				}
 				responseProcessed = true;
 			}
-			else if (ss.eof()){
+			else if (msgType == RABMessage::EMPTY){
 				if (controllerID == "fb00") LOG << "fb00 received EOF" << setw(setwidth) << right << "Time: " << LoopFunctions->getSimTimeInSeconds() << endl;
 			} else {
-				LOG << "runtime_error: " << msgType << endl;
+				LOG << "runtime_error: " << int(msgType) << endl;
 				// throw runtime_error("Runtime Error: " + msgType + "is not a valid message type...\n");
 			}
 		} else {
@@ -1351,7 +1405,7 @@ void CPFA_controller::ProcessMessages(char mode){
  * Calculate a coordinate from a given bearing and range and compare it against the given coordinate.
  * @return true if the given coordinate matches the calculated coordinate.
 */
-bool CPFA_controller::LocalizationCheck(CVector2 givenCoord, Real range, CRadians bearing, string senderID){
+bool CPFA_controller::LocalizationCheck(CVector2 givenCoord, Real range, CRadians bearing, size_t senderIndex){
 
 	// must consider our orientation and adjust the bearing to compensate
 	CRadians adjustedBearing = bearing + GetHeading();
@@ -1363,7 +1417,8 @@ bool CPFA_controller::LocalizationCheck(CVector2 givenCoord, Real range, CRadian
 	// Calculate the origin of the signal (the estimated position of the sender)
 	CVector2 origin = GetPosition() + offset;
 
-	CVector2 realOffset = GetPosition() - LoopFunctions->getTargetLocation(senderID);
+	CVector2 realCoord = LoopFunctions->getTargetLocation(senderIndex);
+	CVector2 realOffset = GetPosition() - realCoord;
 	if (realOffset != offset){
 		// throw runtime_error("Real offset = " + to_string(realOffset.GetX()) + ", " + to_string(realOffset.GetY()) + ", calculated offset = " + to_string(offset.GetX()) + ", " + to_string(offset.GetY()));
 	}
@@ -1373,62 +1428,85 @@ bool CPFA_controller::LocalizationCheck(CVector2 givenCoord, Real range, CRadian
 		// LOG << "true coord detected" << endl;
 		return true;
 	} else {
-		LOG << "Robot " << controllerID << " detected localization error in footbot "<< senderID << endl;
-		LOG << "Given coord: " << givenCoord << ", Calculated coord: " << origin << ", Real coord: "<< LoopFunctions->getTargetLocation(senderID) << endl;
+		LOG << "Robot " << controllerID << " detected localization error in footbot "<< LoopFunctions->getRobotID(senderIndex) << endl;
+		LOG << "Given coord: " << givenCoord << ", Calculated coord: " << origin << ", Real coord: "<< realCoord << endl;
 		// throw runtime_error("Robot " + controllerID + " detected localization error in footbot " + senderID);
 		return false;
 	}
 }
 
 /**
- * Broadcast the responses to all other robots in a single long message.
+ * Broadcast the next fragment of responses to all other robots as a RABMessage::RESPONSE packet.
+ * A fragment holds as many votes as fit in rab_data_size; HasPendingResponse() tells whether
+ * another call is needed to send the rest. Receivers ignore repeated votes from the same sender,
+ * so a fragment that stays on the actuator for several ticks is harmless.
 */
 void CPFA_controller::BroadcastTargetedResponse(){
-	stringstream  ss;
-	ss << "r,";
+	size_t sent = RABMessage::EncodeResponse(msgBuf, robotIndex, responseQueue, responseSent, RABActuator->GetSize());
+	responseSent += sent;
 
-	/**
-	 * Format of message: <message_type>,<target_id>,<sender_id>,<vote_boolean>,<target_id>,<sender_id>,<vote_boolean>,...
-	*/
-	while(!responseQueue.empty()){
-		if (responseQueue.size() == 1) { // don't add comma at the end
-			ss << responseQueue.front().first << "," << controllerID << "," << responseQueue.front().second;
-			responseQueue.pop();
-		} else {
-			ss << responseQueue.front().first << "," << controllerID << "," << responseQueue.front().second << ",";
-			responseQueue.pop();
-		}
+	if (sent == 0 && responseSent < responseQueue.size()){
+		LOG << controllerID << ": rab_data_size is too small for a response, " << responseQueue.size() - responseSent << " votes dropped" << endl;
+		responseSent = responseQueue.size();
 	}
+	if (responseSent >= responseQueue.size()){
+		responseQueue.clear();
+		responseSent = 0;
+	}
+
 	/* Broadcast the message. */
-	Broadcast(ss.str());
+	Broadcast(msgBuf);
 	// if (controllerID == "fb00") LOG << "fb00 responded: " << ss.str() << setw(setwidth) << right << "Time: " << LoopFunctions->getSimTimeInSeconds() << endl;
 }
+/**
+ * Decide on a fault by majority vote, then reset the vote bookkeeping for the next round.
+*/
 void CPFA_controller::ProcessVotes(){
-	size_t trueCount = 0;	// coordinate was correct
-	size_t falseCount = 0;	// coordinate was incorrect
-	for(const auto& vote : voteQueue){
-		if (vote) trueCount++;
-		else falseCount++;
-	}
-	if (trueCount < falseCount) faultDetected = true;
+	if (trueVotes < falseVotes) faultDetected = true;
 	if (hasFault && !faultDetected){
-		LOG << controllerID << ": false negative, voteQueue: ";
-		for (const auto& vote : voteQueue){
-			LOG << vote << ",";
-		}
-		LOG << endl;
+		LOG << controllerID << ": false negative, votes: " << trueVotes << " true, " << falseVotes << " false" << endl;
 	} else if (!hasFault && faultDetected){
-		LOG << controllerID << ": false positive, voteQueue: ";
-		for (const auto& vote : voteQueue){
-			LOG << vote << ",";
-		}
-		LOG << endl;
+		LOG << controllerID << ": false positive, votes: " << trueVotes << " true, " << falseVotes << " false" << endl;
 	}
-	voteQueue.clear();
+	ClearVotes();
+}
+
+void CPFA_controller::ClearVotes(){
+	hasVoted.assign(hasVoted.size(), false);
+	voteCount = 0;
+	trueVotes = 0;
+	falseVotes = 0;
+}
+
+bool CPFA_controller::HasPendingResponse(){
+	return responseSent > 0 && responseSent < responseQueue.size();
 }
 
 void CPFA_controller::ClearRABData(){
 	ClearRAB();
 }
 
+void CPFA_controller::SetRobotIndex(size_t index){
+	robotIndex = index;
+}
+
+size_t CPFA_controller::GetRobotIndex(){
+	return robotIndex;
+}
+
+TrailBuffer& CPFA_controller::GetTargetRayTrail(){
+	return myTrail;
+}
+
+/**
+ * Only keep a trail if it is going to be drawn.
+*/
+void CPFA_controller::UpdateTrailCapacity(){
+	if (!LoopFunctions->Headless && LoopFunctions->DrawTargetRays == 1) {
+		myTrail.SetCapacity(LoopFunctions->TargetRayTrailLength);
+	} else {
+		myTrail.SetCapacity(0);
+	}
+}
+
 REGISTER_CONTROLLER(CPFA_controller, "CPFA_controller")
@@ -10,8 +10,9 @@
 // Ryan Luna 12/28/22
 #include <source/Base/QuarantineZone.h>
 #include <source/Base/Food.h>
+#include <source/Base/TrailBuffer.h>
+#include <source/Base/RABMessage.h>
 
-#include <unordered_set>
 #include <queue>
 
 using namespace std;
@@ -66,10 +67,24 @@ class CPFA_controller : public BaseController {
 
 		void BroadcastLocation();
 		void ProcessMessages(char mode);
-		bool LocalizationCheck(CVector2 givenCoord, Real range, CRadians bearing, string senderID);
+		bool LocalizationCheck(CVector2 givenCoord, Real range, CRadians bearing, size_t senderIndex);
 		void BroadcastTargetedResponse();
+		bool HasPendingResponse();
 		void ClearRABData();
 
+		/* index of this robot in the loop functions' controller registry, used as its id on the RAB */
+		void SetRobotIndex(size_t index);
+		size_t GetRobotIndex();
+
+		TrailBuffer& GetTargetRayTrail();
+		void UpdateTrailCapacity();
+
+		/* deferred world changes, applied by the loop functions in PostStep (see WorldIntents) */
+		bool GetPickupClaim(size_t& foodIdx);
+		void CompletePickup(Food food);
+		void RejectPickup();
+		void ApplyIntents();
+
 		bool broadcastProcessed = false;
 		bool responseProcessed = false;
 
@@ -78,10 +93,43 @@ class CPFA_controller : public BaseController {
 		/* quarantine zone variables */		// Ryan Luna 12/28/22
 		vector<QZone>	QZoneList;
 		vector<Food>	LocalFoodList;
+		vector<size_t>	NearbyFood;		// scratch buffer for FoodIndex queries
 
 		Food FoodBeingHeld;		// Ryan Luna 1/24/23
 
+		/**
+		 * Changes to the loop functions' shared state decided during ControlStep(). The controller
+		 * never writes the loop functions while stepping, so ARGoS can step the controllers on
+		 * several threads; the loop functions resolve the pickup claims and then call
+		 * ApplyIntents() of every robot, in robot index order, from PostStep.
+		 **/
+		struct WorldIntents {
+			enum FidelityUpdate {
+				FIDELITY_KEEP = 0,
+				FIDELITY_SET,
+				FIDELITY_ERASE
+			};
+
+			bool				PickupClaimed;		// wants FoodList[PickupFood]
+			size_t				PickupFood;
+			FidelityUpdate		Fidelity;			// last site fidelity change of the step wins
+			argos::CVector2		FidelityPosition;
+			vector<Pheromone>	Pheromones;
+			bool				ReportZone;			// give ZoneFood around ZoneCenter to the nest
+			vector<Food>		ZoneFood;
+			Food				ZoneCenter;
+			size_t				RealCollected;
+			size_t				FakeCollected;
+			size_t				RealTrails;
+			size_t				FakeTrails;
+			size_t				FalsePositives;
+
+			WorldIntents();
+			void Clear();
+		} Intents;
+
   		string 			controllerID;//qilu 07/26/2016
+		size_t			robotIndex;
 
 		CPFA_loop_functions* LoopFunctions;
 		argos::CRandom::CRNG* RNG;
@@ -89,13 +137,12 @@ class CPFA_controller : public BaseController {
 		/* pheromone trail variables */
 		std::vector<argos::CVector2> TrailToShare;
 		std::vector<argos::CVector2> TrailToFollow;
-		std::vector<argos::CRay3>    MyTrail;
 
 		/* robot position variables */
 		argos::CVector2 SiteFidelityPosition;
   		bool			 updateFidelity; //qilu 09/07/2016
   
-		vector<CRay3> myTrail;
+		TrailBuffer   myTrail;		// recent path for DrawTargetRays, bounded by TargetRayTrailLength
 		CColor        TrailColor;
 
 		bool isInformed;
@@ -106,7 +153,6 @@ class CPFA_controller : public BaseController {
 		bool QZoneStrategy;		// to turn ON/OFF Quarantine Zones
   
 		size_t ResourceDensity;
-		size_t MaxTrailSize;
 		size_t SearchTime;//for informed search
 		size_t BadFoodCount;	// Ryan Luna 01/30/23
 		size_t BadFoodLimit;	// Ryan Luna 01/30/23
@@ -146,7 +192,6 @@ class CPFA_controller : public BaseController {
 
 		argos::Real GetExponentialDecay(argos::Real value, argos::Real time, argos::Real lambda);
 		argos::Real GetBound(argos::Real value, argos::Real min, argos::Real max);
-		argos::Real GetPoissonCDF(argos::Real k, argos::Real lambda);
 
 		void UpdateTargetRayList();
   
@@ -157,12 +202,18 @@ class CPFA_controller : public BaseController {
 		bool isUsingPheromone;
 
 		bool faultInjected;
-		vector<bool> voteQueue;				// for storing vote results
-		unordered_set<string> voterIDs;		// for storing IDs of those who voted (can't vote twice)
+		vector<bool> hasVoted;				// hasVoted[i]: robot i already voted this round (can't vote twice)
+		size_t voteCount;					// number of votes received this round
+		size_t trueVotes;					// votes saying our coordinate was correct
+		size_t falseVotes;					// votes saying our coordinate was incorrect
 		void ProcessVotes();
+		void ClearVotes();
 		bool faultDetected;
 		bool faultLogged;
-		queue<pair<string, bool>> responseQueue;
+		vector<RABMessage::Vote> responseQueue;	// votes to send in the next response broadcast
+		size_t responseSent;					// number of responseQueue votes already broadcast
+		vector<RABMessage::Vote> receivedVotes;	// scratch buffer for decoding responses
+		CByteArray msgBuf;						// scratch buffer for encoding messages
 		// bool broadcastLogged = false;
 		float lastBroadcastTime;
 
@@ -1,7 +1,12 @@
 #include "CPFA_loop_functions.h"
 
+#include <sys/stat.h>
+#include <iomanip>
+#include <limits>
+
 CPFA_loop_functions::CPFA_loop_functions() :
 	RNG(argos::CRandom::CreateRNG("argos")),
+	FaultRNG(argos::CRandom::CreateRNG("argos")),
 	SimTime(0),
     MaxSimTime(0),	//qilu 02/05/2021
 	CollisionTime(0), 
@@ -20,10 +25,17 @@ CPFA_loop_functions::CPFA_loop_functions() :
 	DrawIDs(1),
 	DrawTrails(1),
 	DrawTargetRays(1),
+	TargetRayTrailLength(200),
+	ForceHeadless(0),
+	TicksPerSecond(0),
+	Headless(true),
+	FoodColorsDirty(false),
 	FoodDistribution(2),
 	FakeFoodDistribution(2),
 	NumRealFood(256),			// name modified ** Ryan Luna 11/12/22
 	NumFakeFood(0),			// Ryan Luna 11/12/22
+	ConfiguredNumRealFood(256),
+	ConfiguredNumFakeFood(0),
 	PowerlawFoodUnitCount(256),
 	NumberOfClusters(4),
 	ClusterWidthX(8),
@@ -88,11 +100,14 @@ void CPFA_loop_functions::Init(argos::TConfigurationNode &node) {
 	argos::GetNodeAttribute(CPFA_node, "PrintFinalScore",                   PrintFinalScore);
 
 	UninformedSearchVariation = ToRadians(USV_InDegrees);
+	BuildPoissonTables();
 	argos::TConfigurationNode settings_node = argos::GetNode(node, "settings");
 	
 	argos::GetNodeAttribute(settings_node, "MaxSimTimeInSeconds", MaxSimTime);
+	argos::GetNodeAttributeOrDefault(settings_node, "PhysicsEngine", PhysicsEngineId, PhysicsEngineId);
+	ResolvePhysicsEngine();
 
-	MaxSimTime *= GetSimulator().GetPhysicsEngine("dyn2d").GetInverseSimulationClockTick();//qilu 02/05/2021 dyn2d error
+	MaxSimTime *= TicksPerSecond;//qilu 02/05/2021 dyn2d error
 
 	argos::GetNodeAttribute(settings_node, "MaxSimCounter", 				MaxSimCounter);
 	argos::GetNodeAttribute(settings_node, "VariableFoodPlacement", 		VariableFoodPlacement);
@@ -100,6 +115,9 @@ void CPFA_loop_functions::Init(argos::TConfigurationNode &node) {
 	argos::GetNodeAttribute(settings_node, "DrawIDs", 						DrawIDs);
 	argos::GetNodeAttribute(settings_node, "DrawTrails", 					DrawTrails);
 	argos::GetNodeAttribute(settings_node, "DrawTargetRays", 				DrawTargetRays);
+	argos::GetNodeAttributeOrDefault(settings_node, "TargetRayTrailLength", TargetRayTrailLength, TargetRayTrailLength);
+	argos::GetNodeAttributeOrDefault(settings_node, "Headless", 			ForceHeadless, ForceHeadless);
+	if(ForceHeadless == 1) Headless = true;
 	argos::GetNodeAttribute(settings_node, "FoodDistribution", 				FoodDistribution);
 	argos::GetNodeAttribute(settings_node, "UseAltDistribution", 			UseAltDistribution);
 	argos::GetNodeAttribute(settings_node, "AltClusterWidth", 				AltClusterWidth);
@@ -108,6 +126,8 @@ void CPFA_loop_functions::Init(argos::TConfigurationNode &node) {
 	argos::GetNodeAttribute(settings_node, "FakeFoodDistribution", 			FakeFoodDistribution);
 	argos::GetNodeAttribute(settings_node, "NumRealFood", 					NumRealFood);					// name modified ** Ryan Luna 11/13/22
 	argos::GetNodeAttribute(settings_node, "NumFakeFood", 					NumFakeFood);					// Ryan Luna 11/12/22
+	ConfiguredNumRealFood = NumRealFood;
+	ConfiguredNumFakeFood = NumFakeFood;
 	argos::GetNodeAttribute(settings_node, "PowerlawFoodUnitCount", 		PowerlawFoodUnitCount);
 	argos::GetNodeAttribute(settings_node, "PowerlawFakeFoodUnitCount", 	PowerlawFakeFoodUnitCount);		// Ryan Luna 11/12/22
 	argos::GetNodeAttribute(settings_node, "NumberOfClusters", 				NumberOfClusters);
@@ -117,6 +137,7 @@ void CPFA_loop_functions::Init(argos::TConfigurationNode &node) {
 	argos::GetNodeAttribute(settings_node, "FakeClusterWidthX", 			FakeClusterWidthX);				// Ryan Luna 11/12/22
 	argos::GetNodeAttribute(settings_node, "FakeClusterWidthY", 			FakeClusterWidthY);				// Ryan Luna 11/12/22
 	argos::GetNodeAttribute(settings_node, "FoodRadius", 					FoodRadius);
+	argos::GetNodeAttributeOrDefault(settings_node, "FoodLayoutCache", 	FoodLayoutCache, FoodLayoutCache);
     argos::GetNodeAttribute(settings_node, "NestRadius", 					NestRadius);
 	argos::GetNodeAttribute(settings_node, "NestElevation", 				NestElevation);
     argos::GetNodeAttribute(settings_node, "NestPosition", 					NestPosition);
@@ -134,6 +155,10 @@ void CPFA_loop_functions::Init(argos::TConfigurationNode &node) {
 
 	FoodRadiusSquared = FoodRadius*FoodRadius;
 
+	if(!FoodLayoutCache.empty()) {
+		mkdir(FoodLayoutCache.c_str(), 0755);	// fails harmlessly if it already exists
+	}
+
     //Number of distributed foods ** modified ** Ryan Luna 11/13/22
     if (FoodDistribution == 1){
 		if (UseFakeFoodDoS){
@@ -166,6 +191,11 @@ void CPFA_loop_functions::Init(argos::TConfigurationNode &node) {
 	ForageRangeY.Set(-rangeY, rangeY);
 
 	ArenaWidth = ArenaSize[0];
+
+	// cells are one search radius wide so a density scan touches at most a few cells
+	FoodIndex.Init(CRange<Real>(-ArenaSize.GetX() / 2.0, ArenaSize.GetX() / 2.0),
+				   CRange<Real>(-ArenaSize.GetY() / 2.0, ArenaSize.GetY() / 2.0),
+				   SearchRadius);
 	
 	if(abs(NestPosition.GetX()) < -1){ //quad arena
 		NestRadius *= sqrt(1 + log(ArenaWidth)/log(2));
@@ -177,17 +207,13 @@ void CPFA_loop_functions::Init(argos::TConfigurationNode &node) {
 	MainNest.SetLocation(NestPosition);	// Ryan Luna 1/24/23
 
 	// Send a pointer to this loop functions object to each controller.
-	argos::CSpace::TMapPerType& footbots = GetSpace().GetEntitiesByType("foot-bot");
-	argos::CSpace::TMapPerType::iterator it;
+	BuildControllerRegistry();
     
-    Num_robots = footbots.size();
+    Num_robots = Controllers.size();
     argos::LOG<<"Number of robots="<<Num_robots<<endl;
 
-	for(it = footbots.begin(); it != footbots.end(); it++) {
-		argos::CFootBotEntity& footBot = *argos::any_cast<argos::CFootBotEntity*>(it->second);
-		BaseController& c = dynamic_cast<BaseController&>(footBot.GetControllableEntity().GetController());
-		CPFA_controller& c2 = dynamic_cast<CPFA_controller&>(c);
-		c2.SetLoopFunctions(this);
+	for(size_t i = 0; i < Controllers.size(); i++) {
+		Controllers[i]->SetLoopFunctions(this);
 	}
      
    	NestRadiusSquared = NestRadius*NestRadius;
@@ -202,6 +228,7 @@ void CPFA_loop_functions::Init(argos::TConfigurationNode &node) {
 void CPFA_loop_functions::Reset() {
 	if(VariableFoodPlacement == 0) {
 			RNG->Reset();
+			FaultRNG->Reset();
 	}
 
     GetSpace().Reset();
@@ -211,29 +238,91 @@ void CPFA_loop_functions::Reset() {
     score = 0;
    
     FoodList.clear();
+    FoodColorsDirty = false;
     CollectedFoodList.clear();	
-	PheromoneList.clear();
+	PheromoneList.Clear();
 	FidelityList.clear();
-    TargetRayList.clear();
 
 	RealFoodCollected = 0;
 	FakeFoodCollected = 0;
 	TotalFoodCollected = 0;
+
+	// per-run state, so a simulator Reset() starts a clean trial (the evolver reuses one simulator for many trials)
+	RandomSeed = GetSimulator().GetRandomSeed();
+	SimTime = 0;
+	lastNumCollectedFood = 0;
+	currNumCollectedFood = 0;
+	ForageList.clear();
+	curr_time_in_minutes = 0;
+	last_time_in_minutes = 0;
+	numRealTrails = 0;
+	numFakeTrails = 0;
+	terminate = false;
+	faultInjected = false;
+	lastBroadcastTime = 0;
+	CommunicationMode = 0;
+	ResponseFragment = 0;
+	MainNest = Nest(NestPosition);
     
     SetFoodDistribution();
     
-    argos::CSpace::TMapPerType& footbots = GetSpace().GetEntitiesByType("foot-bot");
-    argos::CSpace::TMapPerType::iterator it;
+	BuildControllerRegistry();
    
-    for(it = footbots.begin(); it != footbots.end(); it++) {
-        argos::CFootBotEntity& footBot = *argos::any_cast<argos::CFootBotEntity*>(it->second);
-        BaseController& c = dynamic_cast<BaseController&>(footBot.GetControllableEntity().GetController());
-        CPFA_controller& c2 = dynamic_cast<CPFA_controller&>(c);
-        MoveEntity(footBot.GetEmbodiedEntity(), c2.GetStartPosition(), argos::CQuaternion(), false);
-    	c2.Reset();
+    for(size_t i = 0; i < Controllers.size(); i++) {
+        MoveEntity(FootBots[i]->GetEmbodiedEntity(), Controllers[i]->GetStartPosition(), argos::CQuaternion(), false);
+    	Controllers[i]->Reset();
     }
 }
 
+/**
+ * Cache the foot-bot entities and their controllers. The foot-bot map and the dynamic_casts
+ * are only paid for here, every other loop in the loop functions walks the Controllers vector.
+ */
+void CPFA_loop_functions::BuildControllerRegistry() {
+	argos::CSpace::TMapPerType& footbots = GetSpace().GetEntitiesByType("foot-bot");
+	argos::CSpace::TMapPerType::iterator it;
+
+	Controllers.clear();
+	FootBots.clear();
+	ControllerIndex.clear();
+	Controllers.reserve(footbots.size());
+	FootBots.reserve(footbots.size());
+
+	for(it = footbots.begin(); it != footbots.end(); it++) {
+		argos::CFootBotEntity& footBot = *argos::any_cast<argos::CFootBotEntity*>(it->second);
+		BaseController& c = dynamic_cast<BaseController&>(footBot.GetControllableEntity().GetController());
+		CPFA_controller& c2 = dynamic_cast<CPFA_controller&>(c);
+		ControllerIndex[footBot.GetId()] = Controllers.size();
+		c2.SetRobotIndex(Controllers.size());
+		Controllers.push_back(&c2);
+		FootBots.push_back(&footBot);
+	}
+
+	UpdateRobotPositions();
+}
+
+/**
+ * The qt user functions call this when they are constructed, which may be before or after Init().
+ * Without it (batch runs, the evolver) the loop functions and controllers stay headless and skip
+ * all state that only exists to be drawn: target ray trails and food highlight colors.
+ */
+void CPFA_loop_functions::EnableVisualization() {
+	if(ForceHeadless == 1) return;
+
+	Headless = false;
+	for(size_t i = 0; i < Controllers.size(); i++) {
+		Controllers[i]->UpdateTrailCapacity();
+	}
+}
+
+void CPFA_loop_functions::UpdateRobotPositions() {
+	RobotPositions.resize(Controllers.size());
+
+	for(size_t i = 0; i < Controllers.size(); i++) {
+		RobotPositions[i] = Controllers[i]->GetRealPosition();
+	}
+}
+
 void CPFA_loop_functions::PreStep() {
     SimTime++;
     curr_time_in_minutes = getSimTimeInSeconds()/60.0;
@@ -250,7 +339,8 @@ void CPFA_loop_functions::PreStep() {
 	}
 
 	// Ryan Luna 11/10/22
-	if(GetSpace().GetSimulationClock() > ResourceDensityDelay) {
+	// the highlight is only drawn, so restore the colors once after the delay and only with a visualizer
+	if(!Headless && FoodColorsDirty && GetSpace().GetSimulationClock() > ResourceDensityDelay) {
     	for(size_t i = 0; i < FoodList.size(); i++) {
 			if (FoodList[i].GetType() == Food::REAL){
 				FoodList[i].SetColor(CColor::BLACK);
@@ -259,16 +349,22 @@ void CPFA_loop_functions::PreStep() {
 			}
             
         }
+		FoodColorsDirty = false;
 	}
  
     if(FoodList.size() == 0) {
 		FidelityList.clear();
-		PheromoneList.clear();
-        TargetRayList.clear();
+		PheromoneList.Clear();
     }
 }
 
 void CPFA_loop_functions::PostStep() {
+	// controllers only record their changes to the shared state while stepping, commit them here
+	ApplyControllerIntents();
+
+	// the robots have moved this tick, snapshot their real positions for the localization checks
+	UpdateRobotPositions();
+
 	// do fault detection post step
 	FaultDetection();
 }
@@ -339,15 +435,10 @@ void CPFA_loop_functions::PostExperiment() {
 		// Now using FilenameHeader defined through the XML ** Ryan Luna 12/09/22
         // header = "./results/"+ type+"_CPFA_r"+num_robots.str()+"_tag"+num_tag.str()+"_"+arena_width.str()+"by"+arena_width.str()+"_quard_arena_" + quardArena.str() +"_";
 
-        unsigned int ticks_per_second = GetSimulator().GetPhysicsEngine("dyn2d").GetInverseSimulationClockTick();//qilu 02/06/2021
+        unsigned int ticks_per_second = TicksPerSecond;//qilu 02/06/2021
         
-        argos::CSpace::TMapPerType& footbots = GetSpace().GetEntitiesByType("foot-bot");
-         
-        for(argos::CSpace::TMapPerType::iterator it = footbots.begin(); it != footbots.end(); it++) {
-            argos::CFootBotEntity& footBot = *argos::any_cast<argos::CFootBotEntity*>(it->second);
-            BaseController& c = dynamic_cast<BaseController&>(footBot.GetControllableEntity().GetController());
-            CPFA_controller& c2 = dynamic_cast<CPFA_controller&>(c);
-            CollisionTime += c2.GetCollisionTime();
+        for(size_t i = 0; i < Controllers.size(); i++) {
+            CollisionTime += Controllers[i]->GetCollisionTime();
         }
              
         // ofstream dataOutput( (FilenameHeader+ "iAntTagData.txt").c_str(), ios::app);
@@ -407,32 +498,23 @@ void CPFA_loop_functions::FaultInjection() {
 
 		LOG << "Fault Injection: Begin..." << endl;
 
-		// Get all footbot entities
-		CSpace::TMapPerType& footbots = GetSpace().GetEntitiesByType("foot-bot");
-
 		// Check robots exist
-		if(footbots.size() < 1) return;
-
-		// Random number generator
-		std::random_device rd;
-		std::mt19937 gen(rd());
+		if(Controllers.size() < 1) return;
 
-		// Distribute numbers between 0 and <size of foot-bot map> - 1
-		std::uniform_int_distribution<> dis(0, footbots.size() - 1);
+		// Draw from a seeded RNG of its own: a seed always injects the same robots, whether or not
+		// the food layout came from the cache (which skips the placement draws on RNG)
+		CRange<UInt32> botRange(0, Controllers.size());
 
 		// Randomly select 'NumBotsToInject' many robots
 		int x = NumBotsToInject;
 
 		for(int i = 0; i < x; ++i) {
 			// Randomly select a foot-bot
-			auto it = std::next(std::begin(footbots), dis(gen));
-			CFootBotEntity& footBot = *any_cast<CFootBotEntity*>(it->second);
+			size_t k = FaultRNG->Uniform(botRange);
 
 			// Inject fault
-			BaseController& c = dynamic_cast<BaseController&>(footBot.GetControllableEntity().GetController());
-			CPFA_controller& c2 = dynamic_cast<CPFA_controller&>(c);
-			LOG << "Injecting fault on foot-bot: " << footBot.GetId().c_str() << ", ";
-			c2.InjectFault(FaultNumber);
+			LOG << "Injecting fault on foot-bot: " << FootBots[k]->GetId().c_str() << ", ";
+			Controllers[k]->InjectFault(FaultNumber);
 		}
 
 		faultInjected = true;
@@ -451,19 +533,14 @@ void CPFA_loop_functions::FaultInjection() {
 */
 void CPFA_loop_functions::FaultDetection() {
 
-	argos::CSpace::TMapPerType& footbots = GetSpace().GetEntitiesByType("foot-bot");
-	argos::CSpace::TMapPerType::iterator it;
-
 	switch (CommunicationMode){
 		case 0:{
 			// broadcast location every 5 seconds
 			if (getSimTimeInSeconds() - lastBroadcastTime >= BroadcastFrequency){
 				// location broadcast
 				LOG << "Time:" << fixed << setprecision(4) << getSimTimeInSeconds() << "\tAll Robots: Broadcasting Location: Begin... ********" << endl;
-				for(it = footbots.begin(); it != footbots.end(); it++) {
-					argos::CFootBotEntity& footBot = *argos::any_cast<argos::CFootBotEntity*>(it->second);
-					BaseController& c = dynamic_cast<BaseController&>(footBot.GetControllableEntity().GetController());
-					CPFA_controller& c2 = dynamic_cast<CPFA_controller&>(c);
+				for(size_t i = 0; i < Controllers.size(); i++) {
+					CPFA_controller& c2 = *Controllers[i];
 					c2.BroadcastLocation();
 					c2.broadcastProcessed = false;
 					c2.responseProcessed = false;
@@ -479,10 +556,8 @@ void CPFA_loop_functions::FaultDetection() {
 			CommunicationMode = 2;
 			// process broadcasted messages
 			LOG << "Time:" << fixed << setprecision(4) << getSimTimeInSeconds() << "\tAll Robots: Processing Messages: Begin..." << endl;
-			for(it = footbots.begin(); it != footbots.end(); it++) {
-				argos::CFootBotEntity& footBot = *argos::any_cast<argos::CFootBotEntity*>(it->second);
-				BaseController& c = dynamic_cast<BaseController&>(footBot.GetControllableEntity().GetController());
-				CPFA_controller& c2 = dynamic_cast<CPFA_controller&>(c);
+			for(size_t i = 0; i < Controllers.size(); i++) {
+				CPFA_controller& c2 = *Controllers[i];
 				c2.ProcessMessages('b');
 				if (!c2.broadcastProcessed){
 					CommunicationMode = 1;
@@ -493,14 +568,15 @@ void CPFA_loop_functions::FaultDetection() {
 			break;
 		}
 		case 2:{
-			// response broadcast
-			LOG << "Time:" << fixed << setprecision(4) << getSimTimeInSeconds() << "\tAll Robots: Response Broadcast: Begin..." << endl;
-			for(it = footbots.begin(); it != footbots.end(); it++) {
-				argos::CFootBotEntity& footBot = *argos::any_cast<argos::CFootBotEntity*>(it->second);
-				BaseController& c = dynamic_cast<BaseController&>(footBot.GetControllableEntity().GetController());
-				CPFA_controller& c2 = dynamic_cast<CPFA_controller&>(c);
-				c2.BroadcastTargetedResponse();
+			// response broadcast, one fragment per robot per tick (see CPFA_controller::BroadcastTargetedResponse)
+			LOG << "Time:" << fixed << setprecision(4) << getSimTimeInSeconds() << "\tAll Robots: Response Broadcast: Begin... (fragment " << ResponseFragment << ")" << endl;
+			for(size_t i = 0; i < Controllers.size(); i++) {
+				// every robot answers on the first fragment, later fragments only come from robots with votes left
+				if (ResponseFragment == 0 || Controllers[i]->HasPendingResponse()){
+					Controllers[i]->BroadcastTargetedResponse();
+				}
 			}
+			ResponseFragment++;
 			CommunicationMode = 3;
 			LOG << "Time:" << fixed << setprecision(4) << getSimTimeInSeconds() << "\tAll Robots: Response Broadcast: Done." << endl;
 			break;
@@ -509,16 +585,26 @@ void CPFA_loop_functions::FaultDetection() {
 			CommunicationMode = 0;
 			// process responses
 			LOG << "Time:" << fixed << setprecision(4) << getSimTimeInSeconds() << "\tAll Robots: Response Processing: Begin..." << endl;
-			for(it = footbots.begin(); it != footbots.end(); it++) {
-				argos::CFootBotEntity& footBot = *argos::any_cast<argos::CFootBotEntity*>(it->second);
-				BaseController& c = dynamic_cast<BaseController&>(footBot.GetControllableEntity().GetController());
-				CPFA_controller& c2 = dynamic_cast<CPFA_controller&>(c);
+			for(size_t i = 0; i < Controllers.size(); i++) {
+				CPFA_controller& c2 = *Controllers[i];
 				c2.ProcessMessages('r');
 				if (!c2.responseProcessed){
 					CommunicationMode = 3;
 				}
 			}
+			// fragments sent in mode 2 are sensed on the next tick, so after the first fragment a single pass suffices
+			if (CommunicationMode == 0){
+				for(size_t i = 0; i < Controllers.size(); i++) {
+					if (Controllers[i]->HasPendingResponse()){
+						CommunicationMode = 2;
+						break;
+					}
+				}
+			}
+			if (CommunicationMode == 0) ResponseFragment = 0;
+
 			if (CommunicationMode == 0) LOG << "Time:" << fixed << setprecision(4) << getSimTimeInSeconds() << "\tAll Robots: Response Processing: Complete" << endl;
+			else if (CommunicationMode == 2) LOG << "Time:" << fixed << setprecision(4) << getSimTimeInSeconds() << "\tAll Robots: Response Processing: More fragments pending..." << endl;
 			else if (CommunicationMode == 3) LOG << "Time:" << fixed << setprecision(4) << getSimTimeInSeconds() << "\tAll Robots: Response Processing: Ongoing..." << endl;
 			break;
 		}
@@ -530,48 +616,168 @@ void CPFA_loop_functions::FaultDetection() {
 	if (getSimTimeInSeconds() >=15) throw std::runtime_error("Fault Detection: Timeout");
 }
 
-argos::CVector2 CPFA_loop_functions::getTargetLocation(string targetID){
-	argos::CSpace::TMapPerType& footbots = GetSpace().GetEntitiesByType("foot-bot");
-	argos::CSpace::TMapPerType::iterator it;
+/**
+ * Real position of a robot as of the last UpdateRobotPositions() call.
+ */
+argos::CVector2 CPFA_loop_functions::getTargetLocation(const string& targetID){
+	unordered_map<string, size_t>::iterator it = ControllerIndex.find(targetID);
 
-	for(it = footbots.begin(); it != footbots.end(); it++) {
-		argos::CFootBotEntity& footBot = *argos::any_cast<argos::CFootBotEntity*>(it->second);
-		BaseController& c = dynamic_cast<BaseController&>(footBot.GetControllableEntity().GetController());
-		CPFA_controller& c2 = dynamic_cast<CPFA_controller&>(c);
-		if (footBot.GetId() == targetID){
-			return c2.GetRealPosition();
-		}
+	if (it != ControllerIndex.end()){
+		return getTargetLocation(it->second);
 	}
 	return argos::CVector2::ZERO;
 }
 
-argos::CColor CPFA_loop_functions::GetFloorColor(const argos::CVector2 &c_pos_on_floor) {
-	return argos::CColor::WHITE;
+argos::CVector2 CPFA_loop_functions::getTargetLocation(size_t robotIndex){
+	if (robotIndex < RobotPositions.size()){
+		return RobotPositions[robotIndex];
+	}
+	return argos::CVector2::ZERO;
 }
 
-void CPFA_loop_functions::UpdatePheromoneList() {
-	// Return if this is not a tick that lands on a 0.5 second interval
-	if ((int)(GetSpace().GetSimulationClock()) % ((int)(GetSimulator().GetPhysicsEngine("dyn2d").GetInverseSimulationClockTick()) / 2) != 0) return;
-	
-	std::vector<Pheromone> new_p_list; 
+const string& CPFA_loop_functions::getRobotID(size_t robotIndex){
+	return FootBots[robotIndex]->GetId();
+}
 
-	argos::Real t = GetSpace().GetSimulationClock() / GetSimulator().GetPhysicsEngine("dyn2d").GetInverseSimulationClockTick();
+/**
+ * Remove FoodList[i] in O(1). The last food is moved into slot i, so FoodList order is not preserved.
+ */
+void CPFA_loop_functions::RemoveFood(size_t i) {
+	size_t last = FoodList.size() - 1;
 
-	for(size_t i = 0; i < PheromoneList.size(); i++) {
+	FoodIndex.Remove(i);
+	if (i != last) {
+		FoodList[i] = FoodList[last];
+		FoodIndex.Relabel(last, i);
+	}
+	FoodList.pop_back();
+}
 
-		PheromoneList[i].Update(t);
-		if(PheromoneList[i].IsActive()) {
-			new_p_list.push_back(PheromoneList[i]);
+/**
+ * Commit what the controllers decided during their ControlStep(), which ARGoS may have run on
+ * several threads. All pickup claims of the tick are resolved in one batch: a food contested by
+ * several robots goes to the nearest one (by real position), ties to the lowest robot index, and
+ * the other claimants keep searching. The outcome depends only on the claims, not on the order
+ * in which the controllers were stepped, so serial and multi-threaded runs pick up the same food.
+ * The granted food is erased before the winners are told, so their local resource density does
+ * not count any food picked up this tick. The remaining intents are then applied robot by robot.
+ */
+void CPFA_loop_functions::ApplyControllerIntents() {
+	PickupClaims.clear();
+	for(size_t r = 0; r < Controllers.size(); r++) {
+		PickupClaim claim;
+		if(!Controllers[r]->GetPickupClaim(claim.Food)) continue;
+
+		claim.Distance = (Controllers[r]->GetRealPosition() - FoodList[claim.Food].GetLocation()).SquareLength();
+		claim.Robot = r;
+		PickupClaims.push_back(claim);
+	}
+
+	// claims on the same food end up adjacent, best claimant first
+	sort(PickupClaims.begin(), PickupClaims.end());
+
+	vector<PickupClaim> granted;
+	vector<Food> pickedUp;
+	for(size_t k = 0; k < PickupClaims.size(); k++) {
+		if(k > 0 && PickupClaims[k].Food == PickupClaims[k - 1].Food) {
+			Controllers[PickupClaims[k].Robot]->RejectPickup();
+		} else {
+			granted.push_back(PickupClaims[k]);
+			pickedUp.push_back(FoodList[PickupClaims[k].Food]);
 		}
 	}
 
-	PheromoneList = new_p_list;
-	new_p_list.clear();
+	// RemoveFood() moves the last food into the freed slot, erase from the back so the other granted indices stay valid
+	for(size_t k = granted.size(); k > 0; k--) {
+		RemoveFood(granted[k - 1].Food);
+	}
+
+	for(size_t k = 0; k < granted.size(); k++) {
+		Controllers[granted[k].Robot]->CompletePickup(pickedUp[k]);
+	}
+
+	for(size_t r = 0; r < Controllers.size(); r++) {
+		Controllers[r]->ApplyIntents();
+	}
+}
+
+argos::CColor CPFA_loop_functions::GetFloorColor(const argos::CVector2 &c_pos_on_floor) {
+	return argos::CColor::WHITE;
+}
+
+/**
+ * Drop the pheromones that have decayed below their threshold. Weights are evaluated lazily
+ * by the readers, so this only pops the store's expiry heap and is cheap enough to run every tick.
+ */
+void CPFA_loop_functions::UpdatePheromoneList() {
+	argos::Real t = (argos::Real)GetSpace().GetSimulationClock() / TicksPerSecond;
+
+	PheromoneList.Expire(t);
 }
 
 // modified to include FakeFoodDistribution ** Ryan Luna 11/13/22
+/**
+ * Without VariableFoodPlacement the RNG is reset before every placement, so the layout
+ * only depends on the settings and the seed. It is then generated once and reused by
+ * later trials, and with FoodLayoutCache set it is saved to and loaded from that
+ * directory, so separate ARGoS runs (e.g. GA evaluations) skip generation too.
+ */
 void CPFA_loop_functions::SetFoodDistribution() {
 
+	// the generators test candidates against FoodIndex, so start it from the current FoodList
+	FoodIndex.Build(FoodList);
+
+	if(VariableFoodPlacement != 0 || !FoodList.empty()) {
+		GenerateFoodDistribution();
+		return;
+	}
+
+	string key = FoodLayoutKey();
+	ostringstream path;
+	path << FoodLayoutCache << "/" << hex << std::hash<string>()(key) << ".layout";
+
+	if(CachedFoodLayout.Key == key || (!FoodLayoutCache.empty() && CachedFoodLayout.Load(path.str(), key))) {
+		FoodList = CachedFoodLayout.FoodList;
+		NumRealFood = CachedFoodLayout.NumRealFood;
+		NumFakeFood = CachedFoodLayout.NumFakeFood;
+		FoodIndex.Build(FoodList);
+		return;
+	}
+
+	GenerateFoodDistribution();
+
+	CachedFoodLayout.Key = key;
+	CachedFoodLayout.FoodList = FoodList;
+	CachedFoodLayout.NumRealFood = NumRealFood;
+	CachedFoodLayout.NumFakeFood = NumFakeFood;
+	if(!FoodLayoutCache.empty() && !CachedFoodLayout.Save(path.str())) {
+		argos::LOGERR << "WARNING: could not save the food layout to " << path.str() << endl;
+	}
+}
+
+/**
+ * Everything the placement generators read, a layout can be reused only if all of it matches.
+ * The food counts are the configured ones: the generators replace NumRealFood and NumFakeFood
+ * with the number of food they managed to place.
+ */
+string CPFA_loop_functions::FoodLayoutKey() {
+	argos::CVector3 ArenaSize = GetSpace().GetArenaSize();
+	ostringstream key;
+	key << setprecision(numeric_limits<argos::Real>::max_digits10)
+		<< "seed=" << RNG->GetSeed()
+		<< " alt=" << UseAltDistribution << ',' << AltClusterWidth << ',' << AltClusterLength
+		<< " dos=" << UseFakeFoodDoS << " fakeonly=" << UseFakeFoodOnly << " densify=" << densify
+		<< " real=" << FoodDistribution << ',' << ConfiguredNumRealFood << ',' << NumberOfClusters << ',' << ClusterWidthX << ',' << ClusterWidthY
+		<< " fake=" << FakeFoodDistribution << ',' << ConfiguredNumFakeFood << ',' << NumFakeClusters << ',' << FakeClusterWidthX << ',' << FakeClusterWidthY
+		<< " powerrank=" << PowerRank
+		<< " food=" << FoodRadius << " nest=" << NestPosition.GetX() << ',' << NestPosition.GetY() << ',' << NestRadius
+		<< " range=" << ForageRangeX.GetMax() << ',' << ForageRangeY.GetMax()
+		<< " arena=" << ArenaSize.GetX() << ',' << ArenaSize.GetY();
+	return key.str();
+}
+
+void CPFA_loop_functions::GenerateFoodDistribution() {
+
 	if (UseAltDistribution){
 		AlternateFakeFoodDistribution();
 	} else if (UseFakeFoodDoS){
@@ -658,7 +864,7 @@ void CPFA_loop_functions::AlternateFakeFoodDistribution(){
 			foodPlaced++;
 
 			Food tmp(WestClusterPosition, Food::FoodType::FAKE);
-			FoodList.push_back(tmp);
+			PlaceFood(tmp);
 
 			WestClusterPosition.SetX(WestClusterPosition.GetX() + foodOffset);
 		}
@@ -678,7 +884,7 @@ void CPFA_loop_functions::AlternateFakeFoodDistribution(){
 			foodPlaced++;
 
 			Food tmp(EastClusterPosition, Food::FoodType::FAKE);
-			FoodList.push_back(tmp);
+			PlaceFood(tmp);
 
 			EastClusterPosition.SetX(EastClusterPosition.GetX() - foodOffset);
 		}
@@ -698,7 +904,7 @@ void CPFA_loop_functions::AlternateFakeFoodDistribution(){
 			foodPlaced++;
 
 			Food tmp(NorthClusterPosition, Food::FoodType::FAKE);
-			FoodList.push_back(tmp);
+			PlaceFood(tmp);
 
 			NorthClusterPosition.SetX(NorthClusterPosition.GetX() - foodOffset);
 		}
@@ -718,7 +924,7 @@ void CPFA_loop_functions::AlternateFakeFoodDistribution(){
 			foodPlaced++;
 
 			Food tmp(SouthClusterPosition, Food::FoodType::FAKE);
-			FoodList.push_back(tmp);
+			PlaceFood(tmp);
 
 			SouthClusterPosition.SetX(SouthClusterPosition.GetX() - foodOffset);
 		}
@@ -742,7 +948,7 @@ void CPFA_loop_functions::RandomFoodDistribution() {
 		}
 
 		Food tmp(placementPosition, Food::FoodType::REAL);
-		FoodList.push_back(tmp);							// Ryan Luna 11/10/22
+		PlaceFood(tmp);							// Ryan Luna 11/10/22
 	}
 }
 
@@ -760,7 +966,7 @@ void CPFA_loop_functions::RandomFakeFoodDistribution(){
 		}
 
 		Food tmp(placementPosition, Food::FoodType::FAKE);
-		FoodList.push_back(tmp);
+		PlaceFood(tmp);
 	}
 }
 
@@ -786,7 +992,7 @@ void CPFA_loop_functions::ClusterFoodDistribution() {
 				foodPlaced++;
 
 				Food tmp(placementPosition, Food::FoodType::REAL);	// Ryan Luna 11/10/22
-				FoodList.push_back(tmp);							// Ryan Luna 11/10/22
+				PlaceFood(tmp);							// Ryan Luna 11/10/22
 
 				placementPosition.SetX(placementPosition.GetX() + foodOffset);
 			}
@@ -825,7 +1031,7 @@ void CPFA_loop_functions::ClusterFakeFoodDistribution(){
 				fakefoodPlaced++;
 
 				Food tmp(placementPosition, Food::FoodType::FAKE);
-				FoodList.push_back(tmp);
+				PlaceFood(tmp);
 
 				placementPosition.SetX(placementPosition.GetX() + foodOffset);
 			}
@@ -923,7 +1129,7 @@ void CPFA_loop_functions::PowerLawFoodDistribution() {
 					// FoodColoringList.push_back(argos::CColor::BLACK);
 
 					Food tmp(placementPosition, Food::FoodType::REAL);
-					FoodList.push_back(tmp);							// Ryan Luna 11/10/22
+					PlaceFood(tmp);							// Ryan Luna 11/10/22
 					placementPosition.SetX(placementPosition.GetX() + foodOffset);
                     if (foodPlaced == singleClusterCount + h * otherClusterCount) break;
 				}
@@ -1026,7 +1232,7 @@ void CPFA_loop_functions::PowerLawFakeFoodDistribution() {
 					// FoodColoringList.push_back(argos::CColor::BLACK);
 
 					Food tmp(L_placementPosition, Food::FoodType::FAKE);
-					FoodList.push_back(tmp);							
+					PlaceFood(tmp);							
 					L_placementPosition.SetX(L_placementPosition.GetX() + L_foodOffset);
                     if (L_fakefoodPlaced == L_singleFakeClusterCount + h * L_otherFakeClusterCount) break;
 				}
@@ -1084,19 +1290,24 @@ bool CPFA_loop_functions::IsCollidingWithNest(argos::CVector2 p) {
       return ( (p - NestPosition).SquareLength() < NRPB_squared) ;
 }
 
+/**
+ * Placement keeps FoodIndex in sync with FoodList (see PlaceFood()), so this only
+ * visits the grid cells around p instead of scanning every placed food.
+ */
 bool CPFA_loop_functions::IsCollidingWithFood(argos::CVector2 p) {
 	argos::Real foodRadiusPlusBuffer = 2.0 * FoodRadius;
-	argos::Real FRPB_squared = foodRadiusPlusBuffer * foodRadiusPlusBuffer;
 
-	for(size_t i = 0; i < FoodList.size(); i++) {
-		if((p - FoodList[i].GetLocation()).SquareLength() < FRPB_squared) return true;
-	}
+	return FoodIndex.Any(p, foodRadiusPlusBuffer, FoodList);
+}
 
-	return false;
+/* append a food during placement and index it right away so later candidates collide with it */
+void CPFA_loop_functions::PlaceFood(const Food& f) {
+	FoodList.push_back(f);
+	FoodIndex.Insert(FoodList.size() - 1, FoodList.back().GetLocation());
 }
 
 unsigned int CPFA_loop_functions::getNumberOfRobots() {
-	return GetSpace().GetEntitiesByType("foot-bot").size();
+	return Controllers.size();
 }
 
 double CPFA_loop_functions::getProbabilityOfSwitchingToSearching() {
@@ -1129,11 +1340,28 @@ double CPFA_loop_functions::getRateOfPheromoneDecay() {
 }
 
 argos::Real CPFA_loop_functions::getSimTimeInSeconds() {
-	int ticks_per_second = GetSimulator().GetPhysicsEngine("dyn2d").GetInverseSimulationClockTick(); //qilu 02/06/2021
+	int ticks_per_second = TicksPerSecond; //qilu 02/06/2021
 	float sim_time = GetSpace().GetSimulationClock();
 	return sim_time/ticks_per_second;
 }
 
+/**
+ * Look the physics engine up once (by the PhysicsEngine setting, or the first engine when it is
+ * not set) and keep its clock rate, so per-tick code does not search the engines by id.
+ */
+void CPFA_loop_functions::ResolvePhysicsEngine() {
+	argos::CPhysicsEngine* engine;
+	if(PhysicsEngineId.empty()) {
+		if(GetSimulator().GetPhysicsEngines().empty()) {
+			THROW_ARGOSEXCEPTION("CPFA_loop_functions: the experiment has no physics engine to read the clock from.");
+		}
+		engine = GetSimulator().GetPhysicsEngines()[0];
+	} else {
+		engine = &GetSimulator().GetPhysicsEngine(PhysicsEngineId);
+	}
+	TicksPerSecond = engine->GetInverseSimulationClockTick();
+}
+
 void CPFA_loop_functions::SetTrial(unsigned int v) {
 }
 
@@ -1165,6 +1393,15 @@ void CPFA_loop_functions::ConfigureFromGenome(Real* g)
 	RateOfSiteFidelity                = g[4];
 	RateOfLayingPheromone             = g[5];
 	RateOfPheromoneDecay              = g[6];
+
+	BuildPoissonTables();
+}
+
+/* the controllers read these tables on every nest arrival, rebuild them whenever the rates change */
+void CPFA_loop_functions::BuildPoissonTables()
+{
+	LayingPheromoneCDF.Build(RateOfLayingPheromone);
+	SiteFidelityCDF.Build(RateOfSiteFidelity);
 }
 
 argos::Real CPFA_loop_functions::getOffsetDistance(){
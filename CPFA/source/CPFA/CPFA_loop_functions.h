@@ -8,15 +8,22 @@
 #include <argos3/plugins/simulator/entities/cylinder_entity.h>
 #include <source/Base/Food.h>	// Ryan Luna 11/10/22
 #include <source/Base/Nest.h>	// Ryan Luna 1/24/23
+#include <source/Base/FoodGrid.h>
+#include <source/Base/FoodLayout.h>
+#include <source/Base/PheromoneStore.h>
+#include <source/Base/PoissonTable.h>
 #include <cmath>				// Ryan Luna 1/25/23
 
 #include <vector>
 #include <algorithm>
 #include <random>
+#include <unordered_map>
 
 using namespace argos;
 using namespace std;
 
+class CPFA_controller;
+
 static const size_t GENOME_SIZE = 7; // There are 7 parameters to evolve
 
 class CPFA_loop_functions : public argos::CLoopFunctions
@@ -61,8 +68,6 @@ class CPFA_loop_functions : public argos::CLoopFunctions
 
 		argos::Real getSimTimeInSeconds();
 
-		std::vector<argos::CColor>   TargetRayColorList;
-
 		unsigned int getNumberOfRobots();
         void increaseNumDistributedFoodByOne();
 		double getProbabilityOfSwitchingToSearching();
@@ -86,7 +91,8 @@ class CPFA_loop_functions : public argos::CLoopFunctions
 
 		void setScore(double s);
 
-		argos::CRandom::CRNG* RNG;
+		argos::CRandom::CRNG* RNG;		// food placement only, a cached layout skips its draws
+		argos::CRandom::CRNG* FaultRNG;	// fault injection, kept apart so the layout cache cannot shift it
         size_t NumDistributedRealFood;		// modified name ** Ryan Luna 11/12/22
 		size_t NumDistributedFakeFood;		// Ryan Luna 11/12/22
 		size_t TotalDistributedFood;		// Ryan Luna 11/12/22
@@ -101,10 +107,21 @@ class CPFA_loop_functions : public argos::CLoopFunctions
 		size_t DrawIDs;
 		size_t DrawTrails;
 		size_t DrawTargetRays;
+		size_t TargetRayTrailLength;	// rays kept per robot for DrawTargetRays
+		size_t ForceHeadless;			// 1 = skip drawing bookkeeping even when the visualizer is loaded
+
+		/* physics engine the simulation clock is read from, resolved once in Init(); the controllers get TicksPerSecond from here */
+		string					PhysicsEngineId;		// "" = the first engine of the experiment
+		size_t					TicksPerSecond;
+		void ResolvePhysicsEngine();
+		bool Headless;					// no drawing bookkeeping, true unless EnableVisualization() was called
+		bool FoodColorsDirty;			// some food was highlighted and must be recolored after ResourceDensityDelay
 		size_t FoodDistribution;
 		size_t FakeFoodDistribution;	// Ryan Luna 11/13/22
 		size_t NumRealFood;			// modified name ** Ryan Luna 11/12/22
 		size_t NumFakeFood;			// Ryan Luna 11/12/22
+		size_t ConfiguredNumRealFood;	// NumRealFood as read from the XML, the generators overwrite NumRealFood with the placed count
+		size_t ConfiguredNumFakeFood;	// NumFakeFood as read from the XML
 		size_t PowerlawFoodUnitCount;
 		size_t PowerlawFakeFoodUnitCount;	// Ryan Luna 11/12/22
 		size_t NumberOfClusters;
@@ -140,6 +157,9 @@ class CPFA_loop_functions : public argos::CLoopFunctions
 		argos::Real RateOfInformedSearchDecay;
 		argos::Real RateOfSiteFidelity;
 		argos::Real RateOfLayingPheromone;
+		PoissonTable LayingPheromoneCDF;	// Poisson CDF of RateOfLayingPheromone by resource density
+		PoissonTable SiteFidelityCDF;		// Poisson CDF of RateOfSiteFidelity by resource density
+		void BuildPoissonTables();
 		argos::Real RateOfPheromoneDecay;
 
 		/* physical robot & world variables */
@@ -153,10 +173,12 @@ class CPFA_loop_functions : public argos::CLoopFunctions
 
 		/* list variables for food & pheromones */
 		std::vector<Food>				FoodList;				// Ryan Luna 11/10/22
+		FoodGrid						FoodIndex;				// spatial index over FoodList, see RemoveFood()
+		FoodLayout						CachedFoodLayout;		// last generated layout, reused while VariableFoodPlacement == 0
+		string							FoodLayoutCache;		// directory of saved layouts, empty = keep them in memory only
 		vector<Food> 					CollectedFoodList;		// Ryan Luna 11/10/22
         map<string, argos::CVector2> 	FidelityList; 
-		std::vector<Pheromone>  	 	PheromoneList; 
-		std::vector<argos::CRay3>    	TargetRayList;
+		PheromoneStore					PheromoneList;	// weights decay lazily, see Pheromone::GetWeight(time)
 		argos::CRange<argos::Real>   	ForageRangeX;
 		argos::CRange<argos::Real>   	ForageRangeY;
   
@@ -203,13 +225,50 @@ class CPFA_loop_functions : public argos::CLoopFunctions
 		bool processRespondDone = false;
 
 		size_t CommunicationMode = 0;
+		size_t ResponseFragment = 0;	// fragment of the response round being sent, see FaultDetection()
+
+		CVector2 getTargetLocation(const string& targetID);
+		CVector2 getTargetLocation(size_t robotIndex);
+		const string& getRobotID(size_t robotIndex);
+
+		/* controller registry, built once in Init() so per-step loops don't query the space */
+		vector<CPFA_controller*>			Controllers;
+		vector<argos::CFootBotEntity*>		FootBots;			// FootBots[i] runs Controllers[i]
+		unordered_map<string, size_t>		ControllerIndex;	// robot id -> index in Controllers
+		void BuildControllerRegistry();
+
+		/* called by the qt user functions, turns on the drawing-only state */
+		void EnableVisualization();
+
+		/* ground truth positions indexed like Controllers, refreshed once per tick */
+		vector<CVector2>	RobotPositions;
+		void UpdateRobotPositions();
+
+		void RemoveFood(size_t i);
+
+		/* applies the controllers' deferred world changes, see CPFA_controller::WorldIntents */
+		void ApplyControllerIntents();
+
+		/* a pickup claim of this tick; for each food the nearest robot wins, ties go to the lowest index */
+		struct PickupClaim {
+			size_t		Food;		// FoodList index
+			Real		Distance;	// squared distance from the robot's real position to the food
+			size_t		Robot;		// Controllers index
 
-		CVector2 getTargetLocation(string targetID);
+			bool operator<(const PickupClaim& other) const {
+				if(Food != other.Food) return Food < other.Food;
+				if(Distance != other.Distance) return Distance < other.Distance;
+				return Robot < other.Robot;
+			}
+		};
+		vector<PickupClaim>	PickupClaims;	// reused every tick
 
 
 	private:
 
 		/* private helper functions */
+		void GenerateFoodDistribution();
+		string FoodLayoutKey();
 		void AlternateFakeFoodDistribution();
 		void RandomFoodDistribution();
 		void ClusterFoodDistribution();
@@ -220,6 +279,7 @@ class CPFA_loop_functions : public argos::CLoopFunctions
         bool IsOutOfBounds(argos::CVector2 p, size_t length, size_t width);
 		bool IsCollidingWithNest(argos::CVector2 p);
 		bool IsCollidingWithFood(argos::CVector2 p);
+		void PlaceFood(const Food& f);
 		double score;
 		int PrintFinalScore;
 
@@ -9,6 +9,7 @@ CPFA_qt_user_functions::CPFA_qt_user_functions() :
 {
 	RegisterUserFunction<CPFA_qt_user_functions, CFootBotEntity>(&CPFA_qt_user_functions::DrawOnRobot);
 	RegisterUserFunction<CPFA_qt_user_functions, CFloorEntity>(&CPFA_qt_user_functions::DrawOnArena);
+	loopFunctions.EnableVisualization();
 }
 
 void CPFA_qt_user_functions::DrawOnRobot(CFootBotEntity& entity) {
@@ -148,16 +149,16 @@ void CPFA_qt_user_functions::DrawFidelity() {
 void CPFA_qt_user_functions::DrawPheromones() {
 
 	Real x, y, weight;
-	vector<CVector2> trail;
 	CColor trailColor = CColor::GREEN, pColor = CColor::GREEN;
+	Real t = loopFunctions.getSimTimeInSeconds();
 
-	    for(size_t i = 0; i < loopFunctions.PheromoneList.size(); i++) {
+	    for(size_t i = 0; i < loopFunctions.PheromoneList.Size(); i++) {
 		       x = loopFunctions.PheromoneList[i].GetLocation().GetX();
 		       y = loopFunctions.PheromoneList[i].GetLocation().GetY();
 
 		       if(loopFunctions.DrawTrails == 1) {
-			          trail  = loopFunctions.PheromoneList[i].GetTrail();
-			          weight = loopFunctions.PheromoneList[i].GetWeight();
+			          const vector<CVector2>& trail = loopFunctions.PheromoneList[i].GetTrail();
+			          weight = loopFunctions.PheromoneList[i].GetWeight(t);
                 
 
              if(weight > 0.25 && weight <= 1.0)        // [ 100.0% , 25.0% )
@@ -180,7 +181,7 @@ void CPFA_qt_user_functions::DrawPheromones() {
 	 DrawCylinder(CVector3(x, y, 0.0), CQuaternion(), loopFunctions.FoodRadius, 0.025, pColor);
 		       } 
          else {
-			          weight = loopFunctions.PheromoneList[i].GetWeight();
+			          weight = loopFunctions.PheromoneList[i].GetWeight(t);
 
              if(weight > 0.25 && weight <= 1.0)        // [ 100.0% , 25.0% )
                  pColor = CColor::GREEN;
@@ -201,8 +202,12 @@ void CPFA_qt_user_functions::DrawTargetRays() {
 	//if(tock == 0) tock = 1;
 
 	//if(tick % tock == 0) {
-		for(size_t j = 0; j < loopFunctions.TargetRayList.size(); j++) {
-			DrawRay(loopFunctions.TargetRayList[j], loopFunctions.TargetRayColorList[j]);
+		for(size_t i = 0; i < loopFunctions.Controllers.size(); i++) {
+			TrailBuffer& trail = loopFunctions.Controllers[i]->GetTargetRayTrail();
+
+			for(size_t j = 0; j < trail.Size(); j++) {
+				DrawRay(trail.GetRay(j), trail.GetColor(j));
+			}
 		}
 	//}
 }
@@ -15,9 +15,16 @@
 #include <chrono> // For clock()
 #include <mpi.h>
 
-#include <sys/wait.h> // For wait(pid)
+#include <sys/wait.h> // For wait(pid) and waitpid()
+#include <cerrno> // For errno after waitpid()
 
 #include <limits> // For float max
+#include <climits> // For PATH_MAX
+#include <unordered_map> // For the fitness cache
+#include <vector>
+#include <algorithm> // For std::find
+#include <cstring> // For memcpy
+#include <regex> // For reading settings of the experiment file
 
 // GA MPI Headers
 #include <ga-mpi/ga.h>
@@ -40,13 +47,46 @@
 
 float objective(GAGenome &);
 float LaunchARGoS(GAGenome &);
+float RunARGoS(GAGenome &);
+float EvaluateInProcess(GAGenome &, int trial, bool & completed);
+void LoadSimulator();
+unsigned long ExperimentAttribute(const string & element, const string & attribute);
+float TrialObjective(GAGenome &, int trial);
+void RunTrials(GAGenome &, int first, int count, float* scores);
+bool CachedTrial(GAGenome &, int trial, float& score);
+void CacheTrial(GAGenome &, int trial, float score);
+void LoadFitnessCache();
+void WriteCheckpoint(const GASimpleGA &, const string & checkpoint_file_name, const string & results_file_name);
+bool ReadCheckpoint(GASimpleGA &, const string & checkpoint_file_name, string & results_file_name);
+string TrialKey(GAGenome &, int trial);
+uint64_t Fnv1aHash(const string &);
+void ReduceBestGenome(GARealGenome &);
 
 int mpi_tasks, mpi_rank;
 
 int elitism = 0;
 int n_trials = 20; // used by the objective function
+bool in_process = false; // run trials in this process on one loaded simulator instead of forking per trial
+unsigned int trial_seed = 12345; // trial i of every genome runs with seed trial_seed + i (in-process mode)
+bool dynamic_balance = false; // hand out single trials to idle MPI workers instead of fixed slices of the population
+int parallel_trials = 1; // trials of a genome run at the same time by this worker, each in its own child process
+bool simulator_loaded = false; // in-process mode: the experiment has been loaded in this process
 double mutation_stdev = 1.00; // Gaussian mutation stdev - will be scaled by possible range
 string experiment_path;
+double racing_z = 0; // stop a genome's trials once mean + racing_z * standard error drops below racing_threshold, 0 disables racing
+int racing_min_trials = 3; // trials run before a genome can be rejected
+float racing_threshold = -std::numeric_limits<float>::max(); // mean score of the previous generation
+long trials_saved = 0; // trials skipped by racing on this worker in the current generation
+string resume_path; // checkpoint to resume the evolution from
+int island_interval = 0; // generations between migrations in island mode, 0 evolves one population across all workers
+int island_migrants = 1; // individuals each island sends to the next one per migration
+unsigned int diversity_samples = 0; // genome pairs sampled to estimate the population diversity, 0 compares all pairs
+int checkpoint_frequency = 1; // write a checkpoint every this many generations, 0 disables checkpoints
+bool use_fitness_cache = true; // reuse trial scores of genomes that were already evaluated, in this run or an earlier one
+std::unordered_map<string, float> fitness_cache; // TrialKey() -> trial score
+std::ofstream fitness_cache_stream; // this worker's cache file, new entries are appended
+unsigned int experiment_seed = 0; // random_seed of the experiment file, used by forked trials (0 = ARGoS picks one)
+unsigned int experiment_threads = 0; // ARGoS worker threads of the experiment file, a forked child does not inherit them
 
 void CPFAInitializer(GAGenome & c);
 int GARealGaussianMutatorStdev(GAGenome &, float);
@@ -74,12 +114,42 @@ int main(int argc, char **argv)
 
     char c='h';
   // Handle command line arguments
-  while ((c = getopt (argc, argv, "t:g:p:c:m:s:h:e:x:")) != -1)
+  while ((c = getopt (argc, argv, "t:g:p:c:m:s:h:e:x:idnz:r:k:I:M:j:D:")) != -1)
     switch (c)
       {
       case 'x':
 	experiment_path = optarg;
       break;
+      case 'i':
+	in_process = true;
+	break;
+      case 'd':
+	dynamic_balance = true;
+	break;
+      case 'n':
+	use_fitness_cache = false;
+	break;
+      case 'z':
+	racing_z = strtod(optarg, NULL);
+	break;
+      case 'r':
+	resume_path = optarg;
+	break;
+      case 'k':
+	checkpoint_frequency = atoi(optarg);
+	break;
+      case 'I':
+	island_interval = atoi(optarg);
+	break;
+      case 'M':
+	island_migrants = atoi(optarg);
+	break;
+      case 'j':
+	parallel_trials = std::max(1, atoi(optarg));
+	break;
+      case 'D':
+	diversity_samples = std::max(0, atoi(optarg));
+	break;
       case 't':
 	n_trials = atoi(optarg);
 	break;
@@ -102,7 +172,7 @@ int main(int argc, char **argv)
         elitism = atoi(optarg);
 	break;
       case 'h':
-	printf("Usage: %s -p {population size} -g {number of generations} -t {number of trials} -c {crossover rate} -m {mutation rate} -s {mutation standard deviation} -e {elitism 0 or 1}", argv[0]);
+	printf("Usage: %s -p {population size} -g {number of generations} -t {number of trials} -c {crossover rate} -m {mutation rate} -s {mutation standard deviation} -e {elitism 0 or 1} -i {evaluate trials in-process} -d {dynamic load balancing of trials across workers} -n {do not use the fitness cache} -z {racing confidence z-score, 0 to run every trial} -r {checkpoint file to resume from} -k {generations between checkpoints, 0 for none} -I {generations between island migrations, 0 for no islands, cannot be combined with -r} -M {migrants per island} -j {trials run in parallel by each worker} -D {genome pairs sampled for the diversity, 0 for all} -x {argos experiment file}\n", argv[0]);
 	break;
       case '?':
         if (optopt == 'p')
@@ -117,6 +187,20 @@ int main(int argc, char **argv)
 	  fprintf (stderr, "Option -%c requires an argument specifying the mutation rate.\n", optopt);
 	else if (optopt == 's')
 	  fprintf (stderr, "Option -%c requires an argument specifying the mutation standard deviation.\n", optopt);
+	else if (optopt == 'z')
+	  fprintf (stderr, "Option -%c requires an argument specifying the racing z-score.\n", optopt);
+	else if (optopt == 'r')
+	  fprintf (stderr, "Option -%c requires an argument specifying the checkpoint file.\n", optopt);
+	else if (optopt == 'k')
+	  fprintf (stderr, "Option -%c requires an argument specifying the checkpoint frequency.\n", optopt);
+	else if (optopt == 'I')
+	  fprintf (stderr, "Option -%c requires an argument specifying the island migration interval.\n", optopt);
+	else if (optopt == 'M')
+	  fprintf (stderr, "Option -%c requires an argument specifying the number of migrants.\n", optopt);
+	else if (optopt == 'j')
+	  fprintf (stderr, "Option -%c requires an argument specifying the number of parallel trials.\n", optopt);
+	else if (optopt == 'D')
+	  fprintf (stderr, "Option -%c requires an argument specifying the number of diversity samples.\n", optopt);
         else if (isprint (optopt))
           fprintf (stderr, "Unknown option `-%c'.\n", optopt);
         else
@@ -135,6 +219,28 @@ int main(int argc, char **argv)
       exit(1);
     }
 
+  experiment_seed = ExperimentAttribute("experiment", "random_seed");
+  experiment_threads = ExperimentAttribute("system", "threads");
+
+  // Islands are not checkpointed, so there is nothing to resume them from
+  if (island_interval > 0 && !resume_path.empty())
+    {
+      if (mpi_rank == 0)
+	printf("ERROR: cannot resume from checkpoint %s in island mode (-r and -I)\n", resume_path.c_str());
+      MPI_Finalize();
+      return 1;
+    }
+
+  if (island_interval > 0 && mpi_rank == 0)
+    {
+      if (elitism != 0)
+	printf("WARNING: -e is ignored in island mode, every island keeps its best individuals\n");
+      if (diversity_samples > 0)
+	printf("WARNING: -D is ignored in island mode, the diversity of an island uses all its genome pairs\n");
+      if (dynamic_balance)
+	printf("WARNING: -d is ignored in island mode, every rank evaluates its own island\n");
+    }
+
   float max_float = std::numeric_limits<float>::max();
 
     //printf("%s:\tworker %d ready.\n", hostname, mpi_rank);                                          
@@ -147,8 +253,13 @@ int main(int argc, char **argv)
     if(strcmp(argv[i++],"seed") == 0)
       seed = atoi(argv[i]);
 
+  // Islands must not all evolve the same population, so each rank gets its own GA seed
+  if (island_interval > 0)
+    seed += mpi_rank;
+
   srand(seed);
   generator.seed(seed);
+  trial_seed = seed - (island_interval > 0 ? mpi_rank : 0);
   // popsize / mpi_tasks must be an integer
   population_size = mpi_tasks * int((double)population_size/(double)mpi_tasks+0.999);
   
@@ -156,8 +267,22 @@ int main(int argc, char **argv)
     {
       printf("Population size: %d\nNumber of trials: %d\nNumber of generations: %d\nCrossover rate: %f\nMutation rate: %f\nMutation stdev: %f\nAllocated MPI workers: %d\n", population_size, n_trials, n_generations, crossover_rate, mutation_rate, mutation_stdev, mpi_tasks);
       	printf("elitism: %d\n", elitism);
+      	printf("in-process trials: %d\n", in_process);
+      	printf("dynamic load balancing: %d\n", dynamic_balance);
+      	printf("parallel trials per worker: %d\n", parallel_trials);
+	if (in_process && parallel_trials > 1 && experiment_threads > 0)
+	  printf("the experiment uses %u threads, so every parallel trial loads its own simulator\n", experiment_threads);
+      	printf("fitness cache: %d\n", use_fitness_cache);
+      	printf("racing z-score: %f\n", racing_z);
+	if (racing_z > 0 && dynamic_balance)
+	  printf("racing is not applied to trials balanced with -d\n");
+	if (island_interval > 0)
+	  printf("island mode: %d individuals per island, %d migrants every %d generations (statistics are those of the population of island 0, the optimum is the best of all islands)\n", population_size/mpi_tasks, island_migrants, island_interval);
     }
 
+  if (use_fitness_cache)
+    LoadFitnessCache();
+
   // Define the genome
   GARealAlleleSetArray allele_array;
   
@@ -176,20 +301,40 @@ int main(int argc, char **argv)
   genome.mutator(GARealGaussianMutatorStdev); // Specify our version of the Gaussuan mutator
   genome.initializer(CPFAInitializer);
  
-  // Now create the GA using the genome and run it.
-  GASimpleGA ga(genome);
+  // Now create the GA using the genome and run it. In island mode every rank evolves its own
+  // share of the population with a GADemeGA and only the migrants are sent between ranks.
+  GASimpleGA* simple_ga = 0;
+  GADemeGA* island_ga = 0;
+  if (island_interval > 0)
+    {
+      island_ga = new GADemeGA(genome);
+      dynamic_balance = false;
+      checkpoint_frequency = 0;
+    }
+  else
+    simple_ga = new GASimpleGA(genome);
+  GAGeneticAlgorithm& ga = (island_ga ? *(GAGeneticAlgorithm*)island_ga : *simple_ga);
+
   GALinearScaling scaling;
   ga.maximize();		// Maximize the objective
  
-  ga.populationSize(population_size);
+  if (island_ga)
+    {
+      int island_size = population_size/mpi_tasks;
+      island_ga->nPopulations(1);
+      island_ga->populationSize(GADemeGA::ALL, island_size);
+      island_ga->nReplacement(GADemeGA::ALL, std::max(1, island_size/2));
+      island_ga->nMigration(island_migrants);
+      island_ga->migrationInterval(island_interval);
+    }
+  else
+    ga.populationSize(population_size);
   ga.nGenerations(n_generations);
   ga.pMutation(mutation_rate);
   ga.pCrossover(crossover_rate);
   ga.scaling(scaling);
-  if (elitism == 1)
-    ga.elitist(gaTrue);
-  else
-    ga.elitist(gaFalse);
+  if (simple_ga)
+    simple_ga->elitist(elitism == 1 ? gaTrue : gaFalse);
   if(mpi_rank == 0)
     ga.scoreFilename("evolution.txt");
   else
@@ -198,6 +343,29 @@ int main(int argc, char **argv)
   ga.scoreFrequency(1);
   ga.flushFrequency(1);
   ga.selectScores(GAStatistics::AllScores);
+
+  // The statistics of a GADemeGA are those of the best individual of each population, so in
+  // island mode evolution.txt and the results file report the population of this rank's island
+  if (island_ga)
+    {
+      ga.scoreFilename("/dev/null");
+      island_ga->populationScoreFilename(0, mpi_rank == 0 ? "evolution.txt" : "/dev/null");
+    }
+  const GAStatistics& statistics = (island_ga ? island_ga->statistics(0) : ga.statistics());
+
+  // Replace the static split of the population across workers with a work queue of single trials,
+  // and estimate the diversity from a sample of genome pairs instead of all of them
+  if (dynamic_balance || (simple_ga && diversity_samples > 0))
+    {
+      GAPopulation pop(ga.population());
+      if (dynamic_balance)
+	{
+	  GAPopulation::trialEvaluator(TrialObjective, n_trials);
+	  pop.evaluator(GAPopulation::DynamicEvaluator);
+	}
+      pop.diversitySamples(diversity_samples);
+      ga.population(pop);
+    }
   
 
   // Pass MPI data to the GA class
@@ -206,7 +374,19 @@ int main(int argc, char **argv)
   //ga.evolve(seed); // Manual generations
 
 // initialize the ga since we are not using the evolve function
-  ga.initialize(seed); // This is essential for the mpi workers to be sychronized
+  string resumed_results_file_name;
+  if (resume_path.empty())
+    ga.initialize(seed); // This is essential for the mpi workers to be sychronized
+  else if (!ReadCheckpoint(*simple_ga, resume_path, resumed_results_file_name))
+    {
+      if (mpi_rank == 0)
+	printf("ERROR: could not resume from checkpoint %s\n", resume_path.c_str());
+      MPI_Finalize();
+      return 1;
+    }
+  else if (mpi_rank == 0)
+    printf("Resuming from generation %d of %s\n", ga.statistics().generation(), resume_path.c_str());
+  racing_threshold = statistics.current(GAStatistics::Mean);
 
     // Name the results file with the current time and date
  time_t t = time(0);   // get time now
@@ -227,7 +407,12 @@ int main(int argc, char **argv)
 
     string results_file_name = ss.str();
 
-    if (mpi_rank == 0)
+    // A resumed run keeps appending to the results file of the run it continues
+    if (!resumed_results_file_name.empty())
+      results_file_name = resumed_results_file_name;
+    string checkpoint_file_name = boost::filesystem::path(results_file_name).replace_extension(".checkpoint").string();
+
+    if (mpi_rank == 0 && resumed_results_file_name.empty())
       {
     // Write output file header
     ofstream results_output_stream;
@@ -264,26 +449,42 @@ int main(int argc, char **argv)
       // Calculate the generation
       ga.step();
 
+      // Every worker has the same scores, so they all race against the same threshold
+      // (in island mode every rank races against the mean of its own island)
+      racing_threshold = statistics.current(GAStatistics::Mean);
+      if (racing_z > 0)
+	{
+	  long generation_saved = 0;
+	  MPI_Reduce(&trials_saved, &generation_saved, 1, MPI_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+	  trials_saved = 0;
+	  if (mpi_rank == 0)
+	    printf("Generation %d: racing skipped %ld trials\n", ga.statistics().generation(), generation_saved);
+	}
+
+      // Each island only knows its own best genome, the results report the best of all of them
+      GARealGenome best_genome(dynamic_cast<const GARealGenome&>(ga.statistics().bestIndividual()));
+      if (island_ga)
+	ReduceBestGenome(best_genome);
+
     if(mpi_rank == 0)
       {
 	generation_end = std::chrono::system_clock::now();
 	std::chrono::duration<double> generation_elapsed_seconds = generation_end-generation_start;
 	ofstream results_output_stream;
 	results_output_stream.open(results_file_name, ios::app);
-       results_output_stream << ga.statistics().generation() 
+       results_output_stream << statistics.generation() 
 			     << ", " << generation_elapsed_seconds.count()
-			     << ", " << ga.statistics().convergence()
-			     << ", " << ga.statistics().current(GAStatistics::Mean)
-			     << ", " << ga.statistics().current(GAStatistics::Maximum)
-			     << ", " << ga.statistics().current(GAStatistics::Minimum)
-			     << ", " << ga.statistics().current(GAStatistics::Deviation)
-			     << ", " << ga.statistics().current(GAStatistics::Diversity);
+			     << ", " << statistics.convergence()
+			     << ", " << statistics.current(GAStatistics::Mean)
+			     << ", " << statistics.current(GAStatistics::Maximum)
+			     << ", " << statistics.current(GAStatistics::Minimum)
+			     << ", " << statistics.current(GAStatistics::Deviation)
+			     << ", " << statistics.current(GAStatistics::Diversity);
        
+	  const GAPopulation& population = (island_ga ? island_ga->population(0) : ga.population());
 	  for (int i = 0; i < GENOME_SIZE; i++)
-	    results_output_stream << ", " << dynamic_cast<const GARealGenome&>(ga.population().best()).gene(i);
+	    results_output_stream << ", " << dynamic_cast<const GARealGenome&>(population.best()).gene(i);
 
-	  
-	  const GARealGenome& best_genome = dynamic_cast<const GARealGenome&>(ga.statistics().bestIndividual());
 	  results_output_stream << endl;
 	  
 	  results_output_stream << "The GA found an optimum at: ";
@@ -293,14 +494,24 @@ int main(int argc, char **argv)
 	  results_output_stream << " with score: " << best_genome.score();
 	  results_output_stream << endl;
 	  results_output_stream.close();
+
+	  // Every worker holds the same GA state, so only the master saves it
+	  if (checkpoint_frequency > 0 && ga.statistics().generation() % checkpoint_frequency == 0)
+	    WriteCheckpoint(*simple_ga, checkpoint_file_name, results_file_name);
       }
 	  }
 	// Display the GA's progress
 	if(mpi_rank == 0)
 	  {
-	    cout << ga.statistics() << " " << ga.parameters() << endl;
+	    cout << statistics << " " << ga.parameters() << endl;
 	  }
 	
+  delete simple_ga;
+  delete island_ga;
+
+  if (simulator_loaded)
+    argos::CSimulator::GetInstance().Destroy();
+
   MPI_Finalize();
 
   program_end = std::chrono::system_clock::now();
@@ -393,9 +604,35 @@ float objective(GAGenome &c)
   std::chrono::time_point<std::chrono::system_clock> start, end;
   start = std::chrono::system_clock::now();
 
-  for (int i = 0; i < n_trials; i++) avg += LaunchARGoS(c);
+  // Race the genome: after racing_min_trials, give up on it as soon as it is unlikely to
+  // reach the previous generation's mean. Its score is then the mean of the trials run.
+  // Without racing all the trials are run in one batch, with racing batches of -j trials.
+  int batch = (racing_z > 0 ? parallel_trials : n_trials);
+  std::vector<float> scores(n_trials);
+  double sum = 0, sum_sq = 0;
+  int trials = 0;
+  while (trials < n_trials)
+    {
+      int count = std::min(batch, n_trials - trials);
+      RunTrials(c, trials, count, &scores[trials]);
+      for (int i = trials; i < trials + count; i++)
+	{
+	  sum += scores[i];
+	  sum_sq += scores[i]*scores[i];
+	}
+      trials += count;
+
+      if (racing_z > 0 && trials >= racing_min_trials && trials < n_trials)
+	{
+	  double mean = sum/trials;
+	  double variance = std::max(0.0, (sum_sq - trials*mean*mean)/(trials - 1));
+	  if (mean + racing_z*sqrt(variance/trials) < racing_threshold)
+	    break;
+	}
+    }
+  trials_saved += n_trials - trials;
   
-  avg /= n_trials;
+  avg = sum/trials;
 
   
   end = std::chrono::system_clock::now();
@@ -452,17 +689,43 @@ float LaunchARGoS(GAGenome& c_genome)
     {
       // In child process - run the argos3 simulation
 
-      /* Convert the received genome to the actual genome type */
-      GARealGenome& cRealGenome = dynamic_cast<GARealGenome&>(c_genome);
+      *ShmPTR = RunARGoS(c_genome);
+
+      // Make this process exit
+      _Exit(0); 
+    }
   
-      Real* cpfa_genome = new Real[GENOME_SIZE];
+  // In parent - wait for child to finish
+  int status = wait(&status);
 
-      // Convert to a convenient format for the argos controller
-      for (int i = 0; i < GENOME_SIZE; i++)
-	cpfa_genome[i] = cRealGenome.gene(i);
-       
-      /*      
-      printf("%s: worker %d started a genome evaluation. (%f, %f, %f, %f, %f, %f, %f)\n", hostname, mpi_rank, 
+  // Make a local copy of the shared fitness value
+  fitness = *ShmPTR;  
+
+  // Release shared memory
+  shmdt((void *) ShmPTR);
+  shmctl(ShmID, IPC_RMID, NULL);
+
+  /* Return the result of the evaluation */  
+  return fitness;
+}
+
+/*
+ * Load the experiment, run one trial of a genome and return its score. This is what the
+ * child processes of LaunchARGoS and RunTrials do when trials are not run in-process.
+ */
+float RunARGoS(GAGenome& c_genome)
+{
+  /* Convert the received genome to the actual genome type */
+  GARealGenome& cRealGenome = dynamic_cast<GARealGenome&>(c_genome);
+  
+  Real* cpfa_genome = new Real[GENOME_SIZE];
+
+  // Convert to a convenient format for the argos controller
+  for (int i = 0; i < GENOME_SIZE; i++)
+    cpfa_genome[i] = cRealGenome.gene(i);
+   
+  /*      
+  printf("%s: worker %d started a genome evaluation. (%f, %f, %f, %f, %f, %f, %f)\n", hostname, mpi_rank, 
 	     cpfa_genome[0],
 	     cpfa_genome[1],
 	     cpfa_genome[2],
@@ -470,66 +733,544 @@ float LaunchARGoS(GAGenome& c_genome)
 	     cpfa_genome[4],
 	     cpfa_genome[5],
 	     cpfa_genome[6]);
-      */
+  */
+
+  /* Redirect LOG and LOGERR to dedicated files to prevent clutter on the screen */
+  std::ofstream cLOGFile("argos_logs/ARGoS_LOG_" + ToString(::getpid()), std::ios::out);
+  LOG.DisableColoredOutput();
+  LOG.GetStream().rdbuf(cLOGFile.rdbuf());
+  std::ofstream cLOGERRFile("argos_logs/ARGoS_LOGERR_" + ToString(::getpid()), std::ios::out);
+  LOGERR.DisableColoredOutput();
+  LOGERR.GetStream().rdbuf(cLOGERRFile.rdbuf());
+
+  /*
+   * Initialize ARGoS
+   */
+  /* The CSimulator class of ARGoS is a singleton. Therefore, to
+   * manipulate an ARGoS experiment, it is enough to get its instance */
+  argos::CSimulator& cSimulator = argos::CSimulator::GetInstance();
+
+  // Set the .argos configuration file
+  cSimulator.SetExperimentFileName(experiment_path);
+  
+  // Load it to configure ARGoS 
+  cSimulator.LoadExperiment();
 
-      /* Redirect LOG and LOGERR to dedicated files to prevent clutter on the screen */
-      std::ofstream cLOGFile("argos_logs/ARGoS_LOG_" + ToString(::getpid()), std::ios::out);
-      LOG.DisableColoredOutput();
-      LOG.GetStream().rdbuf(cLOGFile.rdbuf());
-      std::ofstream cLOGERRFile("argos_logs/ARGoS_LOGERR_" + ToString(::getpid()), std::ios::out);
-      LOGERR.DisableColoredOutput();
-      LOGERR.GetStream().rdbuf(cLOGERRFile.rdbuf());
+  // Get a reference to the loop functions
+  CPFA_loop_functions& cLoopFunctions = dynamic_cast<CPFA_loop_functions&>(cSimulator.GetLoopFunctions());
 
-      /*
-       * Initialize ARGoS
-       */
-      /* The CSimulator class of ARGoS is a singleton. Therefore, to
-       * manipulate an ARGoS experiment, it is enough to get its instance */
-      argos::CSimulator& cSimulator = argos::CSimulator::GetInstance();
+  // Configure the controller with the genome
+  cLoopFunctions.ConfigureFromGenome(cpfa_genome);
 
-      // Set the .argos configuration file
-      cSimulator.SetExperimentFileName(experiment_path);
-      
-      // Load it to configure ARGoS 
-      cSimulator.LoadExperiment();
+  // Run the experiment
+  cSimulator.Execute();
 
-      // Get a reference to the loop functions
-      CPFA_loop_functions& cLoopFunctions = dynamic_cast<CPFA_loop_functions&>(cSimulator.GetLoopFunctions());
+  // Get the performance of this trial
+  float score = cLoopFunctions.Score();
 
-      // Configure the controller with the genome
-      cLoopFunctions.ConfigureFromGenome(cpfa_genome);
+  // For testing
+  //float score = 0;
+  //for (int i = 0; i < GENOME_SIZE; i++) score += cpfa_genome[i];
 
-      // Run the experiment
-      cSimulator.Execute();
+  // Clean up the simulation
+  cSimulator.Destroy();
+  
+  // Clean up the temp genome copy
+  delete [] cpfa_genome;
 
-      // Update performance and store in the shared memory segment
-      *ShmPTR = cLoopFunctions.Score();;
+  return score;
+}
+
+/*
+ * Score of a single trial of a genome. Used by objective() and, with -d, directly by
+ * GAPopulation::DynamicEvaluator so that trials of one genome can run on different workers.
+ */
+float TrialObjective(GAGenome& c, int trial)
+{
+  float score;
+  if (CachedTrial(c, trial, score))
+    return score;
 
-      // For testing
-      //float score = 0;
-      //for (int i = 0; i < GENOME_SIZE; i++) score += cpfa_genome[i];
-      //*ShmPTR = score;
+  bool completed = true;
+  if (in_process)
+    score = EvaluateInProcess(c, trial, completed);
+  else
+    score = LaunchARGoS(c);
 
-      // Clean up the simulation
-      cSimulator.Destroy();
-      
-      // Clean up the temp genome copy
-	delete [] cpfa_genome;
+  // An aborted trial scores 0 this time but must not be remembered as the genome's score
+  if (completed)
+    CacheTrial(c, trial, score);
+  return score;
+}
 
-	// Make this process exit
-      _Exit(0); 
+/*
+ * Run trials first to first + count - 1 of a genome and store their scores in 'scores'.
+ * With -j the trials that are not cached run in child processes, at most parallel_trials
+ * at a time. Each child has its own simulator: in-process children are forked from this
+ * process after the experiment is loaded and share it copy-on-write, the others load it
+ * like LaunchARGoS. A trial whose child dies, fails or cannot be forked scores 0 and is not cached.
+ */
+void RunTrials(GAGenome& c, int first, int count, float* scores)
+{
+  if (parallel_trials <= 1)
+    {
+      for (int k = 0; k < count; k++)
+	scores[k] = TrialObjective(c, first + k);
+      return;
     }
-  
-  // In parent - wait for child to finish
-  int status = wait(&status);
 
-  // Make a local copy of the shared fitness value
-  fitness = *ShmPTR;  
+  std::vector<int> pending;
+  for (int k = 0; k < count; k++)
+    if (!CachedTrial(c, first + k, scores[k]))
+      pending.push_back(k);
+  if (pending.empty())
+    return;
+
+  // The children share this process's simulator only if it has no worker threads: fork()
+  // copies the calling thread alone, so a threaded simulator must be loaded by each child
+  if (in_process && experiment_threads == 0)
+    LoadSimulator();
+
+  int ShmID = shmget(IPC_PRIVATE, count*sizeof(float), IPC_CREAT | 0666);
+  if (ShmID < 0) {
+    printf("ERROR: Allocating shared memory segment in main.cpp:RunTrials() failed.\n");
+    exit(1);
+  }
+  float* ShmPTR = (float*) shmat(ShmID, NULL, 0);
+  if ((float*) ShmPTR == (float*)-1) 
+    {
+      printf("ERROR: Attaching to shared memory segment in main.cpp:RunTrials() failed.\n");
+      exit(1);
+    }
+  for (int k = 0; k < count; k++)
+    ShmPTR[k] = 0;
+
+  std::vector<pid_t> children(count, 0); // child running trial k, 0 once it has been reaped
+  std::vector<bool> completed(count, false); // trial k exited normally with a score
+  size_t next = 0;
+  int running = 0;
+  while (next < pending.size() || running > 0)
+    {
+      // Keep parallel_trials children busy
+      while (next < pending.size() && running < parallel_trials)
+	{
+	  int k = pending[next++];
+	  pid_t pid = fork();
+	  if (pid == 0)
+	    {
+	      bool child_completed = true;
+	      ShmPTR[k] = (in_process ? EvaluateInProcess(c, first + k, child_completed) : RunARGoS(c));
+	      _Exit(child_completed ? 0 : 1);
+	    }
+	  if (pid < 0)
+	    {
+	      printf("ERROR: fork() failed in main.cpp:RunTrials(), trial %d scores 0.\n", first + k);
+	      continue;
+	    }
+	  children[k] = pid;
+	  running++;
+	}
+
+      if (running == 0)
+	break;
+
+      int status;
+      pid_t pid = waitpid(-1, &status, 0);
+      if (pid < 0)
+	{
+	  if (errno == EINTR)
+	    continue;
+	  printf("ERROR: waitpid() failed in main.cpp:RunTrials(), %d trials score 0.\n", running);
+	  break;
+	}
+
+      std::vector<pid_t>::iterator child = std::find(children.begin(), children.end(), pid);
+      if (child == children.end())
+	continue; // not one of this call's trials
+      int k = child - children.begin();
+      *child = 0;
+      running--;
+
+      completed[k] = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+      if (!completed[k])
+	printf("ERROR: trial %d of worker %d did not complete and scores 0.\n", first + k, mpi_rank);
+    }
+
+  for (size_t i = 0; i < pending.size(); i++)
+    {
+      int k = pending[i];
+      scores[k] = (completed[k] ? ShmPTR[k] : 0);
+      if (completed[k])
+	CacheTrial(c, first + k, scores[k]);
+    }
 
-  // Release shared memory
   shmdt((void *) ShmPTR);
   shmctl(ShmID, IPC_RMID, NULL);
+}
 
-  /* Return the result of the evaluation */  
-  return fitness;
+/*
+ * Look a trial up in the fitness cache. Always false when the cache is disabled.
+ */
+bool CachedTrial(GAGenome& c, int trial, float& score)
+{
+  if (!use_fitness_cache)
+    return false;
+
+  std::unordered_map<string, float>::const_iterator it = fitness_cache.find(TrialKey(c, trial));
+  if (it == fitness_cache.end())
+    return false;
+
+  score = it->second;
+  return true;
+}
+
+void CacheTrial(GAGenome& c, int trial, float score)
+{
+  if (!use_fitness_cache)
+    return;
+
+  string key = TrialKey(c, trial);
+  fitness_cache[key] = score;
+  fitness_cache_stream << key << ' ' << score << endl;
+}
+
+/*
+ * Cache key of one trial: the trial's seed followed by the exact bit pattern of every gene.
+ * In-process trials are seeded with trial_seed + trial. Forked trials all run with the seed
+ * in the experiment file, so every trial of a genome gives the same score and shares a key.
+ */
+string TrialKey(GAGenome& c, int trial)
+{
+  GARealGenome& cRealGenome = dynamic_cast<GARealGenome&>(c);
+
+  stringstream key;
+  if (in_process)
+    key << 's' << trial_seed + trial;
+  else
+    key << 'x' << experiment_seed;
+
+  key << std::hex;
+  for (int i = 0; i < GENOME_SIZE; i++)
+    {
+      float gene = cRealGenome.gene(i);
+      uint32_t bits;
+      memcpy(&bits, &gene, sizeof(bits));
+      key << ' ' << bits;
+    }
+
+  return key.str();
+}
+
+/*
+ * The cache lives in fitness_cache/, one file per experiment file contents and worker:
+ * {experiment name}-{FNV-1a hash of the experiment file}-{rank}.txt. Every worker loads the
+ * entries of all workers, so a restarted run reuses whatever was evaluated before,
+ * whatever the number of workers. Each line is a TrialKey() followed by the score.
+ * Only seeded trials are cached: forked trials of an experiment file with random_seed="0"
+ * get a new seed from ARGoS every time, so the cache is turned off for them.
+ */
+void LoadFitnessCache()
+{
+  std::ifstream experiment_stream(experiment_path);
+  stringstream experiment_contents;
+  experiment_contents << experiment_stream.rdbuf();
+
+  string experiment_text = experiment_contents.str();
+
+  if (!in_process && experiment_seed == 0)
+    {
+      if (mpi_rank == 0)
+	printf("fitness cache disabled: %s has no random_seed, so forked trials are not repeatable\n", experiment_path.c_str());
+      use_fitness_cache = false;
+      return;
+    }
+
+  stringstream prefix;
+  prefix << boost::filesystem::path(experiment_path).stem().string() << '-'
+	 << std::hex << Fnv1aHash(experiment_text) << '-';
+
+  boost::filesystem::path cache_dir("fitness_cache");
+  boost::filesystem::create_directories(cache_dir);
+
+  for (boost::filesystem::directory_iterator it(cache_dir); it != boost::filesystem::directory_iterator(); ++it)
+    {
+      string name = it->path().filename().string();
+      if (name.compare(0, prefix.str().size(), prefix.str()) != 0)
+	continue;
+
+      std::ifstream cache_stream(it->path().string());
+      string line;
+      while (getline(cache_stream, line))
+	{
+	  size_t split = line.rfind(' ');
+	  if (split == string::npos)
+	    continue;
+	  fitness_cache[line.substr(0, split)] = strtof(line.c_str() + split + 1, NULL);
+	}
+    }
+
+  fitness_cache_stream.open((cache_dir / (prefix.str() + ToString(mpi_rank) + ".txt")).string(), ios::app);
+  fitness_cache_stream.precision(std::numeric_limits<float>::max_digits10);
+
+  if (mpi_rank == 0)
+    printf("Loaded %lu cached trial scores\n", (unsigned long)fitness_cache.size());
+}
+
+/*
+ * In island mode every rank only knows the best genome of its own island. Find the best
+ * score of all ranks and give every rank the genes of the rank that has it.
+ */
+void ReduceBestGenome(GARealGenome& best_genome)
+{
+  struct { float score; int rank; } local, best;
+  local.score = best_genome.score();
+  local.rank = mpi_rank;
+  MPI_Allreduce(&local, &best, 1, MPI_FLOAT_INT, MPI_MAXLOC, MPI_COMM_WORLD);
+
+  float genes[GENOME_SIZE];
+  for (int i = 0; i < GENOME_SIZE; i++)
+    genes[i] = best_genome.gene(i);
+  MPI_Bcast(genes, GENOME_SIZE, MPI_FLOAT, best.rank, MPI_COMM_WORLD);
+
+  for (int i = 0; i < GENOME_SIZE; i++)
+    best_genome.gene(i, genes[i]);
+  best_genome.score(best.score);
+}
+
+/*
+ * 64-bit FNV-1a. Unlike std::hash its value does not depend on the standard library, so
+ * cache files written by one build are found by another.
+ */
+uint64_t Fnv1aHash(const string& text)
+{
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < text.size(); i++)
+    {
+      hash ^= (unsigned char)text[i];
+      hash *= 1099511628211ULL;
+    }
+  return hash;
+}
+
+/*
+ * Numeric attribute of the first <element> of the experiment file, 0 when it is not set.
+ */
+unsigned long ExperimentAttribute(const string& element, const string& attribute)
+{
+  std::ifstream experiment_stream(experiment_path);
+  stringstream experiment_contents;
+  experiment_contents << experiment_stream.rdbuf();
+  string experiment_text = experiment_contents.str();
+
+  std::smatch match;
+  if (!std::regex_search(experiment_text, match, std::regex("<" + element + "\\b[^>]*\\b" + attribute + "\\s*=\\s*\"([0-9]+)\"")))
+    return 0;
+
+  return strtoul(match[1].str().c_str(), NULL, 10);
+}
+
+/*
+ * Load the experiment into this process's simulator, once.
+ */
+void LoadSimulator()
+{
+  static std::ofstream cLOGFile;
+  static std::ofstream cLOGERRFile;
+
+  if (simulator_loaded)
+    return;
+
+  /* Redirect LOG and LOGERR to dedicated files to prevent clutter on the screen */
+  cLOGFile.open("argos_logs/ARGoS_LOG_" + ToString(::getpid()), std::ios::out);
+  LOG.DisableColoredOutput();
+  LOG.GetStream().rdbuf(cLOGFile.rdbuf());
+  cLOGERRFile.open("argos_logs/ARGoS_LOGERR_" + ToString(::getpid()), std::ios::out);
+  LOGERR.DisableColoredOutput();
+  LOGERR.GetStream().rdbuf(cLOGERRFile.rdbuf());
+
+  argos::CSimulator& cSimulator = argos::CSimulator::GetInstance();
+  cSimulator.SetExperimentFileName(experiment_path);
+  cSimulator.LoadExperiment();
+  simulator_loaded = true;
+}
+
+/*
+ * Evaluate one trial of a genome without leaving this process. The experiment is loaded
+ * once per worker and every trial is a CSimulator::Reset() with its own seed, so the
+ * fork, XML parse, plugin loading and entity creation of LaunchARGoS are paid only once.
+ * A trial that throws scores 0, like a crashed child does in LaunchARGoS, and clears
+ * 'completed'.
+ */
+float EvaluateInProcess(GAGenome& c_genome, int trial, bool& completed)
+{
+  argos::CSimulator& cSimulator = argos::CSimulator::GetInstance();
+
+  LoadSimulator();
+
+  /* Convert the received genome to the actual genome type */
+  GARealGenome& cRealGenome = dynamic_cast<GARealGenome&>(c_genome);
+
+  Real cpfa_genome[GENOME_SIZE];
+  for (int i = 0; i < GENOME_SIZE; i++)
+    cpfa_genome[i] = cRealGenome.gene(i);
+
+  CPFA_loop_functions& cLoopFunctions = dynamic_cast<CPFA_loop_functions&>(cSimulator.GetLoopFunctions());
+
+  // Reset the arena, robots and loop functions with this trial's seed, then apply the genome
+  cSimulator.Reset(trial_seed + trial);
+  cLoopFunctions.ConfigureFromGenome(cpfa_genome);
+
+  try
+    {
+      cSimulator.Execute();
+      return cLoopFunctions.Score();
+    }
+  catch (std::exception& ex)
+    {
+      LOGERR << "Trial " << trial << " aborted: " << ex.what() << std::endl;
+    }
+
+  completed = false;
+  return 0;
+}
+
+/*
+ * Checkpoints hold everything the GA needs to carry on as if it had never stopped: the
+ * population, the statistics (including the generation counter and the best genomes),
+ * both random number generators and the trial seed. The file is written to a temporary
+ * name first, so a run killed while checkpointing still has the previous checkpoint.
+ */
+static const char checkpoint_magic[8] = {'C','P','F','A','C','K','P','1'};
+static const size_t max_generator_state_length = 1 << 16; // the text of any standard engine is far shorter
+
+void WritePopulation(ostream& os, const GAPopulation& pop)
+{
+  int size = pop.size();
+  os.write((const char*)&size, sizeof(size));
+  for (int i = 0; i < size; i++)
+    {
+      const GARealGenome& genome = dynamic_cast<const GARealGenome&>(pop.individual(i));
+      for (int j = 0; j < GENOME_SIZE; j++)
+	{
+	  float gene = genome.gene(j);
+	  os.write((const char*)&gene, sizeof(gene));
+	}
+      float score = genome.score();
+      os.write((const char*)&score, sizeof(score));
+    }
+}
+
+bool ReadPopulation(istream& is, GAPopulation& pop)
+{
+  int size;
+  is.read((char*)&size, sizeof(size));
+  if (!is || size < 1)
+    return false;
+
+  pop.size(size);
+  for (int i = 0; i < size; i++)
+    {
+      GARealGenome& genome = dynamic_cast<GARealGenome&>(pop.individual(i));
+      for (int j = 0; j < GENOME_SIZE; j++)
+	{
+	  float gene;
+	  is.read((char*)&gene, sizeof(gene));
+	  genome.gene(j, gene);
+	}
+      float score;
+      is.read((char*)&score, sizeof(score));
+      genome.score(score);
+    }
+  pop.touch();
+
+  return bool(is);
+}
+
+void WriteCheckpoint(const GASimpleGA& ga, const string& checkpoint_file_name, const string& results_file_name)
+{
+  string temp_file_name = checkpoint_file_name + ".tmp";
+  std::ofstream os(temp_file_name, ios::binary | ios::trunc);
+
+  os.write(checkpoint_magic, sizeof(checkpoint_magic));
+
+  int genome_size = GENOME_SIZE;
+  os.write((const char*)&genome_size, sizeof(genome_size));
+
+  size_t name_length = results_file_name.size();
+  os.write((const char*)&name_length, sizeof(name_length));
+  os.write(results_file_name.data(), name_length);
+
+  os.write((const char*)&trial_seed, sizeof(trial_seed));
+  GAWriteRNGState(os);
+
+  stringstream generator_state;
+  generator_state << generator;
+  size_t state_length = generator_state.str().size();
+  os.write((const char*)&state_length, sizeof(state_length));
+  os.write(generator_state.str().data(), state_length);
+
+  WritePopulation(os, ga.population());
+  ga.statistics().writeState(os);
+  WritePopulation(os, ga.statistics().bestPopulation());
+
+  os.close();
+  if (os.fail() || rename(temp_file_name.c_str(), checkpoint_file_name.c_str()) != 0)
+    printf("ERROR: writing checkpoint %s failed.\n", checkpoint_file_name.c_str());
+}
+
+bool ReadCheckpoint(GASimpleGA& ga, const string& checkpoint_file_name, string& results_file_name)
+{
+  std::ifstream is(checkpoint_file_name, ios::binary);
+
+  char magic[sizeof(checkpoint_magic)];
+  is.read(magic, sizeof(magic));
+  if (!is || memcmp(magic, checkpoint_magic, sizeof(magic)) != 0)
+    return false;
+
+  int genome_size;
+  is.read((char*)&genome_size, sizeof(genome_size));
+  if (!is || genome_size != GENOME_SIZE)
+    return false;
+
+  size_t name_length;
+  is.read((char*)&name_length, sizeof(name_length));
+  // The lengths come from the file, so a corrupt checkpoint must not make us allocate whatever they say
+  if (!is || name_length == 0 || name_length > PATH_MAX)
+    return false;
+  results_file_name.resize(name_length);
+  is.read(&results_file_name[0], name_length);
+  if (!is)
+    return false;
+
+  is.read((char*)&trial_seed, sizeof(trial_seed));
+  if (!is || GAReadRNGState(is) != 0)
+    return false;
+
+  size_t state_length;
+  is.read((char*)&state_length, sizeof(state_length));
+  if (!is || state_length == 0 || state_length > max_generator_state_length)
+    return false;
+  string generator_state(state_length, ' ');
+  is.read(&generator_state[0], state_length);
+  if (!is)
+    return false;
+  stringstream state_stream(generator_state);
+  state_stream >> generator;
+  if (state_stream.fail())
+    return false;
+
+  GAPopulation pop(ga.population());
+  if (!ReadPopulation(is, pop))
+    return false;
+
+  GAStatistics stats(ga.statistics());
+  GAPopulation best(stats.bestPopulation());
+  if (stats.readState(is) != 0 || !ReadPopulation(is, best))
+    return false;
+  stats.bestPopulation(best);
+
+  ga.population(pop);
+  ga.statistics(stats);
+
+  return true;
 }
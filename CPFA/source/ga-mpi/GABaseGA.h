@@ -193,6 +193,8 @@ public:
   GAGenome::AsexualCrossover asexual() const {return across;}
 
   const GAStatistics & statistics() const {return stats;}
+  const GAStatistics & statistics(const GAStatistics & s)
+    {stats.copy(s); return stats;}
   float convergence() const {return stats.convergence();}
   int   generation() const {return stats.generation();}
   void  flushScores() {if(stats.flushFrequency() > 0) stats.flushScores();}
@@ -15,6 +15,12 @@ topology in this implementation).
 redefine the migration method.  If you want to use a different kind of genetic
 algorithm for each population then you'll have to modify the mechanics of the
 step method.
+  When mpi_tasks is greater than one each mpi rank runs its own island (its
+local populations evolve and migrate as above, evaluated without any mpi
+communication) and every migrationInterval generations the best nMigration
+individuals of each rank's last population migrate to the first population of
+the next rank in a ring, replacing its worst individuals.  Migrants are sent
+in the genome's text format, so the genome must implement read and write.
 ---------------------------------------------------------------------------- */
 #ifndef _ga_gademe_h_
 #define _ga_gademe_h_
@@ -40,6 +46,7 @@ public:
   virtual void initialize(unsigned int seed=0);
   virtual void step();
   virtual void migrate();	// new for this derived class
+  virtual void migrateRanks();	// island migration between mpi ranks
   GADemeGA & operator++() { step(); return *this; }
 
   virtual int setptr(const char* name, const void* value);
@@ -73,6 +80,8 @@ public:
   int nReplacement(int i, unsigned int n);
   int nMigration() const {return nmig;}
   int nMigration(unsigned int i);
+  int migrationInterval() const {return migint;}
+  int migrationInterval(unsigned int n) {return migint = n;}
   int nPopulations() const {return npop;}
   int nPopulations(unsigned int i);
 
@@ -85,6 +94,7 @@ public:
 
   const GAStatistics& statistics() const {return stats;}
   const GAStatistics& statistics(unsigned int i) const {return pstats[i];}
+  const char* populationScoreFilename(unsigned int i, const char* fn);
 
 protected:
   unsigned int npop;		// how many populations do we have?
@@ -93,6 +103,7 @@ protected:
   GAPopulation* tmppop;		// temp pop for doing the evolutions
   GAStatistics* pstats;		// statistics for each population
   unsigned int nmig;		// number to migrate from each population
+  unsigned int migint;		// generations between migrations across ranks
 };
 
 #ifdef GALIB_USE_STREAMS
@@ -219,6 +219,7 @@ public:
 
 public:
   int nevals() const {return _neval;}
+  GABoolean evaluated() const {return _evaluated;}
   float score() const { evaluate(); return _score; }
   float score(float s){ _evaluated=gaTrue; return _score=s; }
   float fitness(){return _fitness;}
@@ -62,6 +62,10 @@ diversity
 function can be particularly expensive, especially for large populations.  So
 we store the values and update them only as needed.  The population diversity
 measure is the average of the individual measures (less the diagonal scores).
+  For large populations you can set a number of pairs to sample instead.  The
+population diversity is then the average over that many pairs of individuals
+picked with a private generator (so the evolution itself is not affected), no
+table is kept and div(i,j) compares the two genomes on demand.
 ---------------------------------------------------------------------------- */
 class GAPopulation : public GAID {
 public:
@@ -69,9 +73,16 @@ public:
 
   typedef void (*Initializer)(GAPopulation &);
   typedef void (*Evaluator)(GAPopulation &);
+  typedef float (*TrialEvaluator)(GAGenome &, int trial);
 
   static void DefaultInitializer(GAPopulation &);
   static void DefaultEvaluator(GAPopulation &);
+  static void DynamicEvaluator(GAPopulation &);
+
+// The dynamic evaluator hands out (genome, trial) jobs to the mpi tasks on
+// demand.  If no trial evaluator is set each job is a whole genome evaluation.
+  static void trialEvaluator(TrialEvaluator f, int ntrials)
+    { trialEval = f; nTrials = (ntrials < 1 ? 1 : ntrials); }
 
 public:
   enum SortBasis { RAW, SCALED };
@@ -109,7 +120,11 @@ public:
   float min() const {if(!statted) statistics(); return rawMin;}
   float div() const {if(!divved)  diversity();  return popDiv;}
   float div(unsigned int i, unsigned int j) const 
-    {if(!divved) diversity(); return indDiv[i*n+j];}
+    {if(!divved) diversity(); 
+     return indDiv ? indDiv[i*n+j] : rind[i]->compare(*rind[j]);}
+  unsigned int diversitySamples() const {return divsamples;}
+  unsigned int diversitySamples(unsigned int x)
+    {divved = gaFalse; return divsamples=x;}
   float fitsum() const {if(!scaled) scale(); return fitSum;}
   float fitave() const {if(!scaled) scale(); return fitAve;}
   float fitmax() const {if(!scaled) scale(); return fitMax;}
@@ -182,6 +197,8 @@ public:
   // mpi_tasks and mpi_rank in the population class.
   int vmpi_rank;
   int vmpi_tasks;
+  static TrialEvaluator trialEval;	// single trial objective (optional)
+  static int nTrials;			// trials per genome for trialEval
   int mpi_rank() const {return vmpi_rank;}
   void mpi_rank(unsigned int x) {vmpi_rank=x;}
   int mpi_tasks() const {return vmpi_tasks;}
@@ -204,6 +221,7 @@ protected:
   float rawVar, rawDev;		// variance, standard deviation
   float popDiv;			// overall population diversity [0,)
   float* indDiv;		// table for genome similarities (diversity)
+  unsigned int divsamples;	// pairs sampled for the diversity (0 = all)
   GAGenome** rind;		// the individuals of the population (raw)
   GAGenome** sind;		// the individuals of the population (scaled)
   float fitSum, fitAve;		// sum, ave of the population's fitness scores
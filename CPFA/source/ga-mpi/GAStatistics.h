@@ -89,6 +89,8 @@ public:
   void update(const GAPopulation & pop);
   void reset(const GAPopulation & pop);
   const GAPopulation & bestPopulation() const { return *boa; }
+  const GAPopulation & bestPopulation(const GAPopulation & p)
+    { boa->copy(p); return *boa; }
   const GAGenome & bestIndividual(unsigned int n=0) const;
 
 #ifdef GALIB_USE_STREAMS
@@ -96,6 +98,8 @@ public:
   int scores(STD_OSTREAM & os, int which=NoScores);
   int write(const char* filename) const;
   int write(STD_OSTREAM & os) const;
+  int writeState(STD_OSTREAM & os) const;
+  int readState(STD_ISTREAM & is);
 #endif
 
 // These should be protected (accessible only to the GA class) but for now they
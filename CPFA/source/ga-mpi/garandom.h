@@ -47,6 +47,7 @@ then these functions scale the distribution to that deviation.  Mean is still 0
 #include <stdlib.h>
 #include <ga-mpi/gatypes.h>
 #include <ga-mpi/gaconfig.h>
+#include <ga-mpi/std_stream.h>
 
 // Here we determine which random number generator will be used.  The critical
 // parts here are the name of the random number generator (e.g. rand or random)
@@ -177,4 +178,13 @@ inline double GAGaussianDouble(double dev){ return GAUnitGaussian() * dev; }
 
 const char* GAGetRNG();
 
+// Save and restore the complete state of the random number generators (the
+// seed, the bit generator, the uniform generator and the gaussian cache) in
+// binary form, for checkpointing.  The state is only valid for a build using
+// the same generator.  Both return 0 on success, 1 on failure.
+#ifdef GALIB_USE_STREAMS
+int GAWriteRNGState(STD_OSTREAM &);
+int GAReadRNGState(STD_ISTREAM &);
+#endif
+
 #endif